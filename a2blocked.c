@@ -1,7 +1,9 @@
 #include <string.h>
 
-#include <a2blocked.h>
+#include "a2blocked.h"
 #include "uarray2b.h"
+#include "pool.h"
+#include "tune.h"
 
 // define a private version of each function in A2Methods_T that we implement
 
@@ -9,12 +11,21 @@ typedef A2Methods_UArray2 A2;	// private abbreviation
 
 static A2 new(int width, int height, int size)
 {
-	return UArray2b_new_64K_block(width, height, size);
+	int tilewidth, tileheight;
+	if (Tune_tiles(&tilewidth, &tileheight))
+		return UArray2b_new(width, height, size, tilewidth, tileheight);
+	return UArray2b_new_fitting(width, height, size, Tune_block_bytes());
 }
 
 static A2 new_with_blocksize(int width, int height, int size, int blocksize)
 {
-	return UArray2b_new(width, height, size, blocksize);
+	return UArray2b_new(width, height, size, blocksize, blocksize);
+}
+
+static A2 new_with_tiles(int width, int height, int size, int tilewidth,
+			 int tileheight)
+{
+	return UArray2b_new(width, height, size, tilewidth, tileheight);
 }
 
 static void a2free(A2 * array2p)
@@ -51,6 +62,95 @@ static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
 	UArray2b_map(array2, (applyfun *) apply, cl);
 }
 
+// map_block_major_parallel hands the grid of blocks to the pool (see
+// pool.h), whose threads each take one whole block at a time
+
+struct block_closure {
+	A2 array2;
+	struct UArray2b_layout layout;
+	int width;
+	int height;
+	int size;
+	applyfun *apply;
+	void *cl;
+};
+
+static void apply_blocks(int bcol0, int brow0, int bcol1, int brow1,
+			 void *vcl)
+{
+	struct block_closure *cl = vcl;
+	int tw = cl->layout.tilewidth;
+	int th = cl->layout.tileheight;
+	for (int brow = brow0; brow < brow1; brow++) {
+		for (int bcol = bcol0; bcol < bcol1; bcol++) {
+			int col0 = bcol * tw;
+			int row0 = brow * th;
+			int cols = cl->width - col0 < tw ? cl->width - col0 : tw;
+			int rows = cl->height - row0 < th ? cl->height - row0 : th;
+			size_t b = (size_t)brow * cl->layout.blockwidth + bcol;
+			char *block = cl->layout.blocks +
+				      cl->layout.blockbytes * b;
+			for (int r = 0; r < rows; r++) {
+				char *elem = block +
+					     (size_t)cl->size * tw * r;
+				for (int c = 0; c < cols; c++) {
+					cl->apply(col0 + c, row0 + r,
+						  cl->array2, elem, cl->cl);
+					elem += cl->size;
+				}
+			}
+		}
+	}
+}
+
+static void map_block_major_parallel(A2 array2, A2Methods_applyfun apply,
+				     void *cl)
+{
+	struct block_closure mycl;
+	UArray2b_get_layout(array2, &mycl.layout);
+	mycl.array2 = array2;
+	mycl.width = UArray2b_width(array2);
+	mycl.height = UArray2b_height(array2);
+	mycl.size = UArray2b_size(array2);
+	mycl.apply = (applyfun *) apply;
+	mycl.cl = cl;
+	if (mycl.width == 0 || mycl.height == 0)
+		return;
+	Pool_run_tiles(Pool_default(), mycl.layout.blockwidth,
+		       mycl.layout.blockheight, 1, apply_blocks, &mycl);
+}
+
+typedef void blockfun(int i, int j, int width, int height, int pitch,
+		      UArray2b_T array2b, void *tile, void *cl);
+
+static void map_blocks(A2 array2, A2Methods_blockfun apply, void *cl)
+{
+	UArray2b_map_blocks(array2, (blockfun *) apply, cl);
+}
+
+// map_rows hands out each row of each block, in block-major order
+
+struct row_closure {
+	A2Methods_rowfun *apply;
+	void *cl;
+};
+
+static void apply_rows(int i, int j, int width, int height, int pitch,
+		       UArray2b_T array2, void *tile, void *vcl)
+{
+	struct row_closure *cl = vcl;
+	size_t rowbytes = (size_t)pitch * UArray2b_size(array2);
+	for (int r = 0; r < height; r++)
+		cl->apply(i, j + r, width, array2, 
+			  (char *)tile + rowbytes * r, cl->cl);
+}
+
+static void map_rows(A2 array2, A2Methods_rowfun apply, void *cl)
+{
+	struct row_closure mycl = { apply, cl };
+	UArray2b_map_blocks(array2, apply_rows, &mycl);
+}
+
 struct small_closure {
 	A2Methods_smallapplyfun *apply;
 	void *cl;
@@ -89,6 +189,11 @@ static struct A2Methods_T uarray2_methods_blocked_struct = {
 	NULL,			// small_map_col_major
 	small_map_block_major,
 	small_map_block_major,	// small_map_default
+	map_rows,
+	map_blocks,
+	NULL,			// map_row_major_parallel
+	map_block_major_parallel,
+	new_with_tiles,
 };
 
 // finally the payoff: here is the exported pointer to the struct
@@ -0,0 +1,18 @@
+/*
+ * a2blocked.h
+ *
+ * A2Methods suite for blocked two-dimensional arrays, backed by UArray2b
+ * (see uarray2b.h). new sizes the blocks to suit the machine's caches,
+ * or makes them the tiles a client asked for (see tune.h).
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef A2BLOCKED_INCLUDED
+#define A2BLOCKED_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_blocked;
+
+#endif
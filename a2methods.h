@@ -0,0 +1,107 @@
+/*
+ * a2methods.h
+ *
+ * Interface for the A2Methods suites: a table of function pointers that
+ * lets a client create and walk a two-dimensional array without knowing
+ * how it is laid out (plain, blocked, Z-order, ...).
+ *
+ * This is the course interface extended with span maps. A span map hands
+ * the client a pointer to a run of cells that are contiguous in memory,
+ * so that a kernel can process the run in a tight loop instead of taking
+ * one indirect call per cell. The span maps, and the parallel maps and
+ * rectangular tiles after them, come last in the struct, so that code
+ * built against the course interface still finds its fields where it
+ * expects them; a suite that cannot offer them leaves them NULL.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef A2METHODS_INCLUDED
+#define A2METHODS_INCLUDED
+
+#define T A2Methods_UArray2    // for use in this interface only
+typedef void *T;               // a generic two-dimensional array
+
+typedef void A2Methods_Object; // an unknown sequence of bytes in memory
+
+/* Per-cell apply and map functions */
+typedef void A2Methods_applyfun(int i, int j, T array2, 
+                                A2Methods_Object *ptr, void *cl);
+typedef void A2Methods_mapfun(T array2, A2Methods_applyfun apply, void *cl);
+
+typedef void A2Methods_smallapplyfun(A2Methods_Object *ptr, void *cl);
+typedef void A2Methods_smallmapfun(T array2, A2Methods_smallapplyfun apply, 
+                                   void *cl);
+
+/*
+ * A2Methods_rowfun
+ * 
+ * Applied to the n cells (i, j) .. (i + n - 1, j), which sit one after
+ * another in memory starting at span.
+ */
+typedef void A2Methods_rowfun(int i, int j, int n, T array2, 
+                              A2Methods_Object *span, void *cl);
+typedef void A2Methods_rowmapfun(T array2, A2Methods_rowfun apply, void *cl);
+
+/*
+ * A2Methods_blockfun
+ * 
+ * Applied to a tile whose top-left cell is (i, j) and which covers
+ * width x height cells of the array. Row r of the tile starts pitch
+ * cells after row r - 1; width and height are clipped to the array, so
+ * they may be less than pitch on the right and bottom edges.
+ */
+typedef void A2Methods_blockfun(int i, int j, int width, int height, 
+                                int pitch, T array2, 
+                                A2Methods_Object *tile, void *cl);
+typedef void A2Methods_blockmapfun(T array2, A2Methods_blockfun apply, 
+                                   void *cl);
+
+typedef struct A2Methods_T {
+        /* creates an array; blocksize is a hint some suites ignore */
+        T    (*new)(int width, int height, int size);
+        T    (*new_with_blocksize)(int width, int height, int size, 
+                                   int blocksize);
+
+        void (*free)(T *array2p);
+
+        /* observe properties of the array */
+        int  (*width)    (T array2);
+        int  (*height)   (T array2);
+        int  (*size)     (T array2);
+        /* 1 or -1 if unblocked; the tile height if tiles are not square */
+        int  (*blocksize)(T array2);
+
+        /* returns a pointer to the cell in column i, row j */
+        A2Methods_Object *(*at)(T array2, int i, int j);
+
+        /* mapping functions; NULL if the suite cannot walk that way */
+        A2Methods_mapfun *map_row_major;
+        A2Methods_mapfun *map_col_major;
+        A2Methods_mapfun *map_block_major;
+        A2Methods_mapfun *map_default;   /* the fastest for this suite */
+
+        A2Methods_smallmapfun *small_map_row_major;
+        A2Methods_smallmapfun *small_map_col_major;
+        A2Methods_smallmapfun *small_map_block_major;
+        A2Methods_smallmapfun *small_map_default;
+
+        /* span maps: contiguous row runs, and whole blocks as tiles */
+        A2Methods_rowmapfun   *map_rows;
+        A2Methods_blockmapfun *map_blocks;
+
+        /* parallel maps: every cell once, spread over the default pool
+           (see pool.h) in tiles of cells or whole blocks, in no
+           particular order; apply must be safe to run on several threads
+           at once */
+        A2Methods_mapfun *map_row_major_parallel;
+        A2Methods_mapfun *map_block_major_parallel;
+
+        /* creates an array of tilewidth x tileheight blocks, a hint as
+           blocksize is */
+        T    (*new_with_tiles)(int width, int height, int size,
+                               int tilewidth, int tileheight);
+} *A2Methods_T;
+
+#undef T
+#endif
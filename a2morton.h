@@ -0,0 +1,17 @@
+/*
+ * a2morton.h
+ *
+ * A2Methods suite for two-dimensional arrays stored in Z-order
+ * (see uarray2m.h). Its default map walks the Z-curve.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef A2MORTON_INCLUDED
+#define A2MORTON_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_morton;
+
+#endif
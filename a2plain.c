@@ -1,7 +1,8 @@
 #include <string.h>
 
-#include <a2plain.h>
+#include "a2plain.h"
 #include "uarray2.h"
+#include "pool.h"
 
 /************************************************/
 /* Define a private version of each function in */
@@ -21,6 +22,13 @@ static A2Methods_UArray2 new_with_blocksize(int width, int height, int size,
   (void) blocksize;
   return UArray2_new(width, height, size);;
 }
+static A2Methods_UArray2 new_with_tiles(int width, int height, int size,
+                                        int tilewidth, int tileheight)
+{
+  (void) tilewidth;
+  (void) tileheight;
+  return UArray2_new(width, height, size);
+}
 static void a2free(A2Methods_UArray2 * array2p)
 {
         UArray2_free((UArray2_T *) array2p);
@@ -62,6 +70,55 @@ static void map_col_major(A2Methods_UArray2 uarray2,
   UArray2_map_col_major(uarray2, (applyfun *) apply, cl);
 }
 
+typedef void rowfun(int i, int j, int n, UArray2_T uarray2, void *span,
+                    void *cl);
+static void map_rows(A2Methods_UArray2 uarray2,
+                     A2Methods_rowfun apply,
+                     void *cl)
+{
+  UArray2_map_rows(uarray2, (rowfun *) apply, cl);
+}
+
+/* map_row_major_parallel walks the array in TILE x TILE tiles, which the
+   pool hands out to its threads (see pool.h); cells within a tile go in
+   row-major order */
+
+#define TILE 64
+
+struct tile_closure {
+  UArray2_T uarray2;
+  applyfun *apply;
+  void     *cl;
+};
+
+static void apply_tiles(int col0, int row0, int col1, int row1, void *vcl)
+{
+  struct tile_closure *cl = vcl;
+  int width = UArray2_width(cl->uarray2);
+  int height = UArray2_height(cl->uarray2);
+  int size = UArray2_size(cl->uarray2);
+  int x0 = col0 * TILE;
+  int x1 = col1 * TILE < width ? col1 * TILE : width;
+  int y1 = row1 * TILE < height ? row1 * TILE : height;
+  for (int j = row0 * TILE; j < y1; j++) {
+    char *elem = UArray2_at(cl->uarray2, x0, j);
+    for (int i = x0; i < x1; i++) {
+      cl->apply(i, j, cl->uarray2, elem, cl->cl);
+      elem += size;
+    }
+  }
+}
+
+static void map_row_major_parallel(A2Methods_UArray2 uarray2,
+                                   A2Methods_applyfun apply,
+                                   void *cl)
+{
+  int cols = (UArray2_width(uarray2) + TILE - 1) / TILE;
+  int rows = (UArray2_height(uarray2) + TILE - 1) / TILE;
+  struct tile_closure mycl = { uarray2, (applyfun *) apply, cl };
+  Pool_run_tiles(Pool_default(), cols, rows, 1, apply_tiles, &mycl);
+}
+
 struct small_closure {
   A2Methods_smallapplyfun *apply; 
   void                    *cl;
@@ -111,6 +168,11 @@ static struct A2Methods_T uarray2_methods_plain_struct = {
   small_map_col_major,
   NULL,                   /* small_map_block_major */
   small_map_row_major,    /* small_map_default     */
+  map_rows,
+  NULL,                   /* map_blocks            */
+  map_row_major_parallel,
+  NULL,                   /* map_block_major_parallel */
+  new_with_tiles,
 };
 
 // finally the payoff: here is the exported pointer to the struct
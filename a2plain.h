@@ -0,0 +1,17 @@
+/*
+ * a2plain.h
+ *
+ * A2Methods suite for plain (row-major) two-dimensional arrays, backed
+ * by UArray2 (see uarray2.h).
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef A2PLAIN_INCLUDED
+#define A2PLAIN_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_plain;
+
+#endif
@@ -1,9 +1,17 @@
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2morton.h"
+#include "a2view.h"
+#include "kernels.h"
+#include "orient.h"
+#include "pool.h"
+#include "uarray2b.h"
 
 
 #define W 13
@@ -84,6 +92,7 @@ static inline void check(A2 a, int i, int j, unsigned n)
 bool has_minimum_methods(A2Methods_T m)
 {
         return m->new != NULL && m->new_with_blocksize != NULL
+                && m->new_with_tiles != NULL
                 && m->free != NULL && m->width != NULL && m->height != NULL
                 && m->size != NULL && m->blocksize != NULL && m->at != NULL;
 }
@@ -120,6 +129,329 @@ static inline void copy_unsigned(A2Methods_T methods, A2 a,
         *p = n;
 }
 
+/* Span maps must hand out every cell exactly once, at the right place */
+
+static void check_row(int i, int j, int n, A2 a, void *span, void *cl)
+{
+        unsigned *p = span;
+        int *counter = cl;
+        for (int k = 0; k < n; k++) {
+                assert(p + k == methods->at(a, i + k, j));
+                assert(p[k] == (unsigned)(1000 * (i + k) + j));
+        }
+        *counter += n;
+}
+
+static void check_block(int i, int j, int width, int height, int pitch,
+                        A2 a, void *tile, void *cl)
+{
+        unsigned *p = tile;
+        int *counter = cl;
+        for (int r = 0; r < height; r++) {
+                for (int c = 0; c < width; c++) {
+                        assert(p + r * pitch + c == methods->at(a, i + c, 
+                                                                j + r));
+                }
+        }
+        *counter += width * height;
+}
+
+/* Parallel maps must too, from whatever thread they run on */
+
+static void check_cell(int i, int j, A2 a, void *elem, void *cl)
+{
+        unsigned *p = elem;
+        unsigned char *seen = cl;
+        assert(p == methods->at(a, i, j));
+        assert(*p == (unsigned)(1000 * i + j));
+        assert(seen[j * W + i] == 0);
+        seen[j * W + i] = 1;
+}
+
+static void check_parallel(A2 array)
+{
+        A2Methods_mapfun *maps[] = { methods->map_row_major_parallel,
+                                     methods->map_block_major_parallel };
+        for (unsigned m = 0; m < sizeof(maps) / sizeof(maps[0]); m++) {
+                if (maps[m] == NULL)
+                        continue;
+                unsigned char seen[W * H] = { 0 };
+                maps[m](array, check_cell, seen);
+                for (int k = 0; k < W * H; k++)
+                        assert(seen[k] == 1);
+        }
+}
+
+static void check_spans(A2 array)
+{
+        int counter;
+        if (methods->map_rows) {
+                counter = 0;
+                methods->map_rows(array, check_row, &counter);
+                assert(counter == W * H);
+        }
+        if (methods->map_blocks) {
+                counter = 0;
+                methods->map_blocks(array, check_block, &counter);
+                assert(counter == W * H);
+        }
+}
+
+/* Rectangular tiles must address and walk like square blocks */
+
+static void check_tiles(int tilewidth, int tileheight)
+{
+        methods = uarray2_methods_blocked;
+        A2 array = methods->new_with_tiles(W, H, sizeof(unsigned), tilewidth,
+                                           tileheight);
+        assert(methods->width(array) == W && methods->height(array) == H);
+        assert(UArray2b_tilewidth(array) == tilewidth);
+        assert(UArray2b_tileheight(array) == tileheight);
+        assert(methods->blocksize(array) == tileheight);
+        for (int i = 0; i < W; i++)
+                for (int j = 0; j < H; j++)
+                        copy_unsigned(methods, array, i, j, 1000 * i + j);
+
+        unsigned char seen[W * H] = { 0 };
+        methods->map_block_major(array, check_cell, seen);
+        for (int k = 0; k < W * H; k++)
+                assert(seen[k] == 1);
+        check_spans(array);
+        check_parallel(array);
+        methods->free(&array);
+}
+
+/* Work stealing must still run every unit of a loop exactly once */
+
+#define POOL_COLS 120
+#define POOL_ROWS 80
+
+static atomic_uchar visits[POOL_ROWS][POOL_COLS];
+
+static void visit(int col0, int row0, int col1, int row1, void *cl)
+{
+        (void)cl;
+        for (int r = row0; r < row1; r++)
+                for (int c = col0; c < col1; c++)
+                        atomic_fetch_add(&visits[r][c], 1);
+}
+
+static void check_pool_tiles(void)
+{
+        for (int threads = 2; threads <= 8; threads *= 2) {
+                Pool_T pool = Pool_new(threads);
+                for (int n = 0; n < 3000; n++) {
+                        int cols = 1 + rand() % POOL_COLS;
+                        int rows = 1 + rand() % POOL_ROWS;
+                        for (int r = 0; r < rows; r++)
+                                for (int c = 0; c < cols; c++)
+                                        visits[r][c] = 0;
+                        Pool_run_tiles(pool, cols, rows, 1 + rand() % 7,
+                                       visit, NULL);
+                        for (int r = 0; r < rows; r++)
+                                for (int c = 0; c < cols; c++)
+                                        assert(visits[r][c] == 1);
+                }
+                Pool_free(&pool);
+        }
+}
+
+/* 
+ * Kernels must put every cell where Orient_apply says, whatever the
+ * layout, orientation, and cell size. Byte k of source cell (i, j) is
+ * cell_byte(i, j, k), so any cell of any copy can be checked in place.
+ */
+
+struct layout {
+        A2Methods_T methods;
+        int tilewidth, tileheight;      /* 0 x 0 for the suite's own */
+};
+
+static inline unsigned char cell_byte(int i, int j, int k)
+{
+        return (unsigned char)(i * 37 + j * 101 + k * 13 + (j >> 3) * 7);
+}
+
+static A2 new_image(const struct layout *layout, int width, int height,
+                    int size)
+{
+        if (layout->tilewidth == 0)
+                return layout->methods->new(width, height, size);
+        return layout->methods->new_with_tiles(width, height, size,
+                                               layout->tilewidth,
+                                               layout->tileheight);
+}
+
+static A2 source_image(const struct layout *layout, int width, int height,
+                       int size)
+{
+        A2 image = new_image(layout, width, height, size);
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        unsigned char *p = layout->methods->at(image, i, j);
+                        for (int k = 0; k < size; k++)
+                                p[k] = cell_byte(i, j, k);
+                }
+        }
+        return image;
+}
+
+/* dst must hold the width x height source image under orient */
+static void check_oriented(A2Methods_T m, A2 dst, Orient_T orient,
+                           int width, int height, int size)
+{
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        int col = i, row = j;
+                        Orient_apply(orient, width, height, &col, &row);
+                        unsigned char *p = m->at(dst, col, row);
+                        for (int k = 0; k < size; k++)
+                                assert(p[k] == cell_byte(i, j, k));
+                }
+        }
+}
+
+static void check_transform(const struct layout *layout, Orient_T orient,
+                            int width, int height, int size)
+{
+        A2Methods_T m = layout->methods;
+        int transposed = orient & ORIENT_TRANSPOSE;
+        int dstwidth = transposed ? height : width;
+        int dstheight = transposed ? width : height;
+        A2Methods_mapfun *maps[] = { m->map_default, m->map_col_major,
+                                     m->map_row_major_parallel,
+                                     m->map_block_major_parallel };
+
+        A2 src = source_image(layout, width, height, size);
+        for (unsigned n = 0; n < sizeof(maps) / sizeof(maps[0]); n++) {
+                if (maps[n] == NULL)
+                        continue;
+                A2 dst = new_image(layout, dstwidth, dstheight, size);
+                assert(Kernels_transform(m, maps[n], src, dst, orient));
+                check_oriented(m, dst, orient, width, height, size);
+                m->free(&dst);
+        }
+        m->free(&src);
+}
+
+static void check_gather(const struct layout *layout, Orient_T orient,
+                         int width, int height, int size)
+{
+        A2Methods_T m = layout->methods;
+        int transposed = orient & ORIENT_TRANSPOSE;
+        int dstwidth = transposed ? height : width;
+        int dstheight = transposed ? width : height;
+        int rects[][4] = { { 0, 0, dstwidth, dstheight },
+                           { dstwidth / 3, dstheight / 4,
+                             dstwidth - dstwidth / 3, dstheight / 2 },
+                           { dstwidth - 1, dstheight - 1, 1, 1 } };
+
+        A2 src = source_image(layout, width, height, size);
+        for (unsigned n = 0; n < sizeof(rects) / sizeof(rects[0]); n++) {
+                int col0 = rects[n][0], row0 = rects[n][1];
+                int w = rects[n][2], h = rects[n][3];
+                if (w == 0 || h == 0)
+                        continue;
+                unsigned char *buf = malloc((size_t)w * h * size);
+                assert(buf != NULL);
+                assert(Kernels_gather(m, src, orient, col0, row0, w, h,
+                                      buf));
+                for (int y = 0; y < h; y++) {
+                        for (int x = 0; x < w; x++) {
+                                int i = col0 + x, j = row0 + y;
+                                Orient_apply(Orient_inverse(orient), 
+                                             dstwidth, dstheight, &i, &j);
+                                unsigned char *p = buf + 
+                                        ((size_t)y * w + x) * size;
+                                for (int k = 0; k < size; k++)
+                                        assert(p[k] == cell_byte(i, j, k));
+                        }
+                }
+                free(buf);
+        }
+        m->free(&src);
+}
+
+/* Scatters the source in bands of 5 rows, each cut in 3 pieces */
+static void check_scatter(const struct layout *layout, Orient_T orient,
+                          int width, int height, int size)
+{
+        A2Methods_T m = layout->methods;
+        int transposed = orient & ORIENT_TRANSPOSE;
+        A2 dst = new_image(layout, transposed ? height : width,
+                           transposed ? width : height, size);
+        int piece = (width + 2) / 3;
+        unsigned char *buf = malloc((size_t)piece * 5 * size);
+        assert(buf != NULL);
+
+        for (int row0 = 0; row0 < height; row0 += 5) {
+                int h = height - row0 < 5 ? height - row0 : 5;
+                for (int col0 = 0; col0 < width; col0 += piece) {
+                        int w = width - col0 < piece ? width - col0 : piece;
+                        unsigned char *p = buf;
+                        for (int y = 0; y < h; y++)
+                                for (int x = 0; x < w; x++)
+                                        for (int k = 0; k < size; k++)
+                                                *p++ = cell_byte(col0 + x,
+                                                                 row0 + y,
+                                                                 k);
+                        assert(Kernels_scatter(m, dst, orient, col0, row0,
+                                               w, h, buf));
+                }
+        }
+        check_oriented(m, dst, orient, width, height, size);
+        free(buf);
+        m->free(&dst);
+}
+
+/* Not every suite can turn an image where it lies; those that can must */
+static void check_inplace(const struct layout *layout, Orient_T orient,
+                          int width, int height, int size)
+{
+        A2Methods_T m = layout->methods;
+        A2 image = source_image(layout, width, height, size);
+        if (Kernels_transform_inplace(m, image, orient)) {
+                int transposed = orient & ORIENT_TRANSPOSE;
+                assert(m->width(image) == (transposed ? height : width));
+                assert(m->height(image) == (transposed ? width : height));
+                check_oriented(m, image, orient, width, height, size);
+        }
+        m->free(&image);
+}
+
+static void check_kernels(void)
+{
+        struct layout layouts[] = {
+                { uarray2_methods_plain, 0, 0 },
+                { uarray2_methods_blocked, 0, 0 },
+                { uarray2_methods_blocked, 4, 4 },
+                { uarray2_methods_blocked, 8, 2 },
+                { uarray2_methods_blocked, 2, 16 },
+                { uarray2_methods_morton, 0, 0 },
+        };
+        int dims[][2] = { { 1, 1 }, { W, H }, { 64, 3 }, { 3, 64 },
+                          { 100, 77 } };
+        int sizes[] = { 1, 2, 3, 6, 12, 5 };
+
+        for (unsigned l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++)
+        for (unsigned d = 0; d < sizeof(dims) / sizeof(dims[0]); d++)
+        for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for (Orient_T o = ORIENT_IDENTITY; o < ORIENT_COUNT; o++) {
+                int width = dims[d][0], height = dims[d][1];
+                check_gather(&layouts[l], o, width, height, sizes[s]);
+                check_scatter(&layouts[l], o, width, height, sizes[s]);
+                if (o == ORIENT_IDENTITY)
+                        continue;       /* no copy to make */
+                check_transform(&layouts[l], o, width, height, sizes[s]);
+                check_inplace(&layouts[l], o, width, height, sizes[s]);
+        }
+
+        /* and an image big enough to be split over the pool many ways */
+        for (unsigned l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++)
+                for (Orient_T o = ORIENT_IDENTITY + 1; o < ORIENT_COUNT; o++)
+                        check_transform(&layouts[l], o, 1000, 700, 3);
+}
+
 static void test_methods(A2Methods_T methods_under_test) 
 {
         methods = methods_under_test;
@@ -157,6 +489,8 @@ static void test_methods(A2Methods_T methods_under_test)
                         assert(*p == n);
                 }
         }
+        check_spans(array);
+        check_parallel(array);
         double_row_major_plus();
         methods->free(&array);
 }
@@ -165,8 +499,18 @@ int main(int argc, char *argv[])
 {
         assert(argc == 1);
         (void)argv;
+        Pool_T pool = Pool_new(4);
+        Pool_set_default(pool);
         test_methods(uarray2_methods_plain);
-        /*  test_methods(uarray2_methods_blocked); */
+        test_methods(uarray2_methods_blocked);
+        test_methods(uarray2_methods_morton);
+        test_methods(uarray2_methods_view);
+        check_tiles(4, 2);
+        check_tiles(8, 1);
+        check_tiles(3, 5);
+        check_kernels();
+        check_pool_tiles();
+        Pool_free(&pool);
         printf("Passed.\n");  /* only if we reach this point without
                                * assertion failure
                                */
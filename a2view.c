@@ -0,0 +1,255 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "a2view.h"
+#include "a2plain.h"
+
+// a view is where to look, and how to turn what is seen there
+
+struct view {
+	A2Methods_T methods;	// suite of the array underneath
+	A2Methods_UArray2 array;
+	Orient_T orient;	// applied to array, before cropping
+	Orient_T inverse;	// undoes orient
+	int srcwidth, srcheight;	// of array
+	int col, row;		// the crop, in oriented coordinates
+	int width, height;
+	int owned;		// free array with the view
+};
+
+typedef A2Methods_UArray2 A2;	// private abbreviation
+
+static struct view *view_new(A2Methods_T methods, A2 array, Orient_T orient,
+			     int col, int row, int width, int height, int owned)
+{
+	assert(methods != NULL && array != NULL);
+	assert(orient >= 0 && orient < ORIENT_COUNT);
+
+	struct view *view = malloc(sizeof(*view));
+	assert(view != NULL);
+	view->methods = methods;
+	view->array = array;
+	view->orient = orient;
+	view->inverse = Orient_inverse(orient);
+	view->srcwidth = methods->width(array);
+	view->srcheight = methods->height(array);
+
+	int fullwidth = (orient & ORIENT_TRANSPOSE) ? view->srcheight
+						    : view->srcwidth;
+	int fullheight = (orient & ORIENT_TRANSPOSE) ? view->srcwidth
+						     : view->srcheight;
+	assert(col >= 0 && row >= 0 && width >= 0 && height >= 0);
+	assert(col + width <= fullwidth && row + height <= fullheight);
+	view->col = col;
+	view->row = row;
+	view->width = width;
+	view->height = height;
+	view->owned = owned;
+	return view;
+}
+
+extern A2 A2View_new(A2Methods_T methods, A2 array, Orient_T orient,
+		     int col, int row, int width, int height)
+{
+	return view_new(methods, array, orient, col, row, width, height, 0);
+}
+
+extern void A2View_get_source(A2 array2, struct A2View_source *source)
+{
+	struct view *view = array2;
+	assert(view != NULL && source != NULL);
+	source->methods = view->methods;
+	source->array = view->array;
+	source->orient = view->orient;
+	source->col = view->col;
+	source->row = view->row;
+}
+
+// define a private version of each function in A2Methods_T that we implement
+
+static A2 new(int width, int height, int size)
+{
+	A2 array = uarray2_methods_plain->new(width, height, size);
+	return view_new(uarray2_methods_plain, array, ORIENT_IDENTITY, 0, 0,
+			width, height, 1);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+	(void)blocksize;	// what matters is the layout underneath
+	return new(width, height, size);
+}
+
+static A2 new_with_tiles(int width, int height, int size, int tilewidth,
+			 int tileheight)
+{
+	(void)tilewidth;
+	(void)tileheight;
+	return new(width, height, size);
+}
+
+static void a2free(A2 * array2p)
+{
+	assert(array2p != NULL && *array2p != NULL);
+	struct view *view = *array2p;
+	if (view->owned) {
+		view->methods->free(&view->array);
+	}
+	free(view);
+	*array2p = NULL;
+}
+
+static int width(A2 array2)
+{
+	struct view *view = array2;
+	assert(view != NULL);
+	return view->width;
+}
+static int height(A2 array2)
+{
+	struct view *view = array2;
+	assert(view != NULL);
+	return view->height;
+}
+static int size(A2 array2)
+{
+	struct view *view = array2;
+	assert(view != NULL);
+	return view->methods->size(view->array);
+}
+static int blocksize(A2 array2)
+{
+	(void)array2;
+	return 1;
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+	struct view *view = array2;
+	assert(view != NULL);
+	assert(i >= 0 && i < view->width && j >= 0 && j < view->height);
+
+	// back from the oriented image to the array underneath
+	int col = view->col + i;
+	int row = view->row + j;
+	Orient_apply(view->inverse, (view->orient & ORIENT_TRANSPOSE) ?
+		     view->srcheight : view->srcwidth,
+		     (view->orient & ORIENT_TRANSPOSE) ?
+		     view->srcwidth : view->srcheight, &col, &row);
+	return view->methods->at(view->array, col, row);
+}
+
+static void map_row_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+	int w = width(array2);
+	int h = height(array2);
+	for (int j = 0; j < h; j++) {
+		for (int i = 0; i < w; i++) {
+			apply(i, j, array2, at(array2, i, j), cl);
+		}
+	}
+}
+
+static void map_col_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+	int w = width(array2);
+	int h = height(array2);
+	for (int i = 0; i < w; i++) {
+		for (int j = 0; j < h; j++) {
+			apply(i, j, array2, at(array2, i, j), cl);
+		}
+	}
+}
+
+// the default map walks the array underneath in its own best order
+
+struct source_closure {
+	struct view *view;
+	A2Methods_applyfun *apply;
+	void *cl;
+};
+
+static void apply_source(int i, int j, A2 array2, void *elem, void *vcl)
+{
+	struct source_closure *cl = vcl;
+	struct view *view = cl->view;
+	(void)array2;
+	Orient_apply(view->orient, view->srcwidth, view->srcheight, &i, &j);
+	i -= view->col;
+	j -= view->row;
+	if (i >= 0 && i < view->width && j >= 0 && j < view->height) {
+		cl->apply(i, j, view, elem, cl->cl);
+	}
+}
+
+static void map_default(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+	struct view *view = array2;
+	assert(view != NULL);
+	assert(view->methods->map_default != NULL);
+	struct source_closure mycl = { view, apply, cl };
+	view->methods->map_default(view->array, apply_source, &mycl);
+}
+
+struct small_closure {
+	A2Methods_smallapplyfun *apply;
+	void *cl;
+};
+
+static void apply_small(int i, int j, A2 array2, void *elem, void *vcl)
+{
+	struct small_closure *cl = vcl;
+	(void)i;
+	(void)j;
+	(void)array2;
+	cl->apply(elem, cl->cl);
+}
+
+static void small_map_row_major(A2 a2, A2Methods_smallapplyfun apply,
+				void *cl)
+{
+	struct small_closure mycl = { apply, cl };
+	map_row_major(a2, apply_small, &mycl);
+}
+
+static void small_map_col_major(A2 a2, A2Methods_smallapplyfun apply,
+				void *cl)
+{
+	struct small_closure mycl = { apply, cl };
+	map_col_major(a2, apply_small, &mycl);
+}
+
+static void small_map_default(A2 a2, A2Methods_smallapplyfun apply, void *cl)
+{
+	struct small_closure mycl = { apply, cl };
+	map_default(a2, apply_small, &mycl);
+}
+
+static struct A2Methods_T uarray2_methods_view_struct = {
+	new,
+	new_with_blocksize,
+	a2free,
+	width,
+	height,
+	size,
+	blocksize,
+	at,
+	map_row_major,
+	map_col_major,
+	NULL,			// map_block_major
+	map_default,
+	small_map_row_major,
+	small_map_col_major,
+	NULL,			// small_map_block_major
+	small_map_default,
+	NULL,			// map_rows: a view's rows need not be contiguous
+	NULL,			// map_blocks
+	NULL,			// map_row_major_parallel
+	NULL,			// map_block_major_parallel
+	new_with_tiles,
+};
+
+// finally the payoff: here is the exported pointer to the struct
+
+A2Methods_T uarray2_methods_view = &uarray2_methods_view_struct;
@@ -0,0 +1,62 @@
+/*
+ * a2view.h
+ *
+ * A2Methods suite for views: an existing array seen under an
+ * orientation (see orient.h), optionally cropped to a rectangle. A view
+ * copies nothing. width, height, at, and the maps remap coordinates on
+ * the fly into the array underneath, so a transformed image costs no
+ * memory until someone reads it - typically a writer, which can use
+ * A2View_get_source to read the array underneath in storage order.
+ *
+ * The suite's own new and new_with_blocksize make an unoriented view of
+ * a fresh plain array, which the view owns.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef A2VIEW_INCLUDED
+#define A2VIEW_INCLUDED
+
+#include "a2methods.h"
+#include "orient.h"
+
+extern A2Methods_T uarray2_methods_view;
+
+/*
+ * A2View_new
+ *
+ * Returns a view of array, which belongs to methods, as it would be
+ * after applying orient, cropped to the width x height rectangle whose
+ * top left cell is (col, row) of the oriented image. The view does not
+ * own array: freeing the view leaves array alone, and array must outlive
+ * the view.
+ *
+ * Expectations: methods and array are not NULL, orient is an
+ *               orientation, and the rectangle lies within the oriented
+ *               image. All are CREs.
+ */
+extern A2Methods_UArray2 A2View_new(A2Methods_T methods,
+                                    A2Methods_UArray2 array,
+                                    Orient_T orient, int col, int row,
+                                    int width, int height);
+
+/* What a view looks at: cell (i, j) of the view is cell (col + i,
+   row + j) of array under orient */
+struct A2View_source {
+        A2Methods_T methods;
+        A2Methods_UArray2 array;
+        Orient_T orient;
+        int col, row;
+};
+
+/*
+ * A2View_get_source
+ *
+ * Fills in *source for view.
+ *
+ * Expectations: view is a view and source is not NULL (CREs).
+ */
+extern void A2View_get_source(A2Methods_UArray2 view,
+                              struct A2View_source *source);
+
+#endif
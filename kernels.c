@@ -0,0 +1,1236 @@
+/*
+ * kernels.c
+ *
+ * Implementation of the transform kernels.
+ *
+ * Each kernel body below is an always-inline function of the
+ * orientation and the element size. The INSTANCES macros stamp out one
+ * copy per (orientation x element size), with both as compile-time
+ * constants, so the compiler folds away the orientation tests and turns
+ * each cell copy into a few moves. Destination addresses are stepped
+ * along with the source pointer where the layout allows it (plain), and
+ * computed with shifts and masks (blocked) or bit interleaving (Z-order)
+ * otherwise.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "assert.h"
+#include "kernels.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "a2morton.h"
+#include "uarray2.h"
+#include "uarray2b.h"
+#include "uarray2m.h"
+#include "morton.h"
+#include "transpose.h"
+#include "pool.h"
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+/* Side, in cells, of the tiles plain_kernel transposes a tile at a time */
+#define TILE 64
+
+/* The storage layouts (and traversal orders) that have kernels */
+enum layout { PLAIN_ROWS, PLAIN_COLS, BLOCKED, MORTON, LAYOUTS };
+
+/* Everything a kernel needs to address one array directly */
+struct image {
+    char *base;
+    int width;
+    int height;
+    size_t size;
+    size_t stride;              /* plain: bytes per row */
+    size_t blockbytes;          /* blocked: bytes per block */
+    int blockwidth;             /* blocked: blocks per row of blocks */
+    int blockheight;            /* blocked: rows of blocks */
+    int log2tilewidth;          /* blocked: log2 of cells across a block */
+    int log2tileheight;         /* blocked: log2 of cells down a block */
+    int log2side;               /* Z-order: log2 of the tile side */
+    int tilecols;               /* Z-order: tiles across a row of tiles */
+    int tilerows;               /* Z-order: rows of tiles */
+};
+
+/*
+ * oriented_col, oriented_row
+ *
+ * The column and row that (x, y) of a width x height source lands on
+ * under orient.
+ */
+static ALWAYS_INLINE int oriented_col(Orient_T orient, int x, int y,
+                                      int width, int height)
+{
+    int u = (orient & ORIENT_TRANSPOSE) ? y : x;
+    int w = (orient & ORIENT_TRANSPOSE) ? height : width;
+    return (orient & ORIENT_FLIP_H) ? w - 1 - u : u;
+}
+
+static ALWAYS_INLINE int oriented_row(Orient_T orient, int x, int y,
+                                      int width, int height)
+{
+    int v = (orient & ORIENT_TRANSPOSE) ? x : y;
+    int h = (orient & ORIENT_TRANSPOSE) ? width : height;
+    return (orient & ORIENT_FLIP_V) ? h - 1 - v : v;
+}
+
+/*
+ * plain_kernel
+ *
+ * The rectangle of plain source cells in columns col0 .. col1 - 1 of
+ * rows row0 .. row1 - 1 into plain destination. The destination address
+ * is linear in (x, y), so it is just a pointer stepped by dx per source
+ * column and by dy per source row; cols selects a column-major walk.
+ * Transposing row-major walks go a TILE x TILE tile at a time.
+ */
+static ALWAYS_INLINE void plain_kernel(const struct image *src,
+                                       const struct image *dst,
+                                       Orient_T orient, size_t size,
+                                       int cols, int col0, int row0,
+                                       int col1, int row1)
+{
+    int transposed = orient & ORIENT_TRANSPOSE;
+    ptrdiff_t across = (ptrdiff_t)size;
+    ptrdiff_t down = (ptrdiff_t)dst->stride;
+    ptrdiff_t hstep = (orient & ORIENT_FLIP_H) ? -across : across;
+    ptrdiff_t vstep = (orient & ORIENT_FLIP_V) ? -down : down;
+    ptrdiff_t dx = transposed ? vstep : hstep;
+    ptrdiff_t dy = transposed ? hstep : vstep;
+    char *origin = dst->base +
+                   ((orient & ORIENT_FLIP_H) ? (dst->width - 1) * across : 0) +
+                   ((orient & ORIENT_FLIP_V) ? (dst->height - 1) * down : 0);
+
+    if (cols) {
+        for (int x = col0; x < col1; x++) {
+            const char *s = src->base + row0 * src->stride + x * size;
+            char *d = origin + row0 * dy + x * dx;
+            for (int y = row0; y < row1; y++) {
+                memcpy(d, s, size);
+                s += src->stride;
+                d += dy;
+            }
+        }
+    } else if (transposed) {
+        /* a tile at a time, so the destination rows it writes stay cached */
+        for (int y0 = row0; y0 < row1; y0 += TILE) {
+            int y1 = row1 - y0 < TILE ? row1 : y0 + TILE;
+            for (int x0 = col0; x0 < col1; x0 += TILE) {
+                int x1 = col1 - x0 < TILE ? col1 : x0 + TILE;
+                for (int y = y0; y < y1; y++) {
+                    const char *s = src->base + y * src->stride + x0 * size;
+                    char *d = origin + y * dy + x0 * dx;
+                    for (int x = x0; x < x1; x++) {
+                        memcpy(d, s, size);
+                        s += size;
+                        d += dx;
+                    }
+                }
+            }
+        }
+    } else {
+        for (int y = row0; y < row1; y++) {
+            const char *s = src->base + y * src->stride + col0 * size;
+            char *d = origin + y * dy + col0 * dx;
+            for (int x = col0; x < col1; x++) {
+                memcpy(d, s, size);
+                s += size;
+                d += dx;
+            }
+        }
+    }
+}
+
+/*
+ * blocked_at
+ *
+ * Address of (col, row) in a blocked image with power-of-two tiles.
+ */
+static ALWAYS_INLINE char *blocked_at(const struct image *im, int col,
+                                      int row, size_t size)
+{
+    int xshift = im->log2tilewidth;
+    int yshift = im->log2tileheight;
+    int xmask = (1 << xshift) - 1;
+    int ymask = (1 << yshift) - 1;
+    return im->base +
+           im->blockbytes * ((size_t)(row >> yshift) * im->blockwidth +
+                             (col >> xshift)) +
+           size * ((size_t)(row & ymask) << xshift | (col & xmask));
+}
+
+/*
+ * block_extent
+ *
+ * The address of block (bcol, brow), its top-left cell, and how many of
+ * its columns and rows lie inside the image.
+ */
+static ALWAYS_INLINE const char *block_extent(const struct image *im,
+                                              int bcol, int brow,
+                                              int *col0, int *row0,
+                                              int *cols, int *rows)
+{
+    int tw = 1 << im->log2tilewidth;
+    int th = 1 << im->log2tileheight;
+    *col0 = bcol << im->log2tilewidth;
+    *row0 = brow << im->log2tileheight;
+    *cols = im->width - *col0 < tw ? im->width - *col0 : tw;
+    *rows = im->height - *row0 < th ? im->height - *row0 : th;
+    return im->base +
+           im->blockbytes * ((size_t)brow * im->blockwidth + bcol);
+}
+
+/*
+ * blocked_kernel
+ *
+ * Blocked source into blocked destination, one source block at a time,
+ * for the source blocks in columns bcol0 .. bcol1 - 1 of block rows
+ * brow0 .. brow1 - 1.
+ */
+static ALWAYS_INLINE void blocked_kernel(const struct image *src,
+                                         const struct image *dst,
+                                         Orient_T orient, size_t size,
+                                         int bcol0, int brow0, int bcol1,
+                                         int brow1)
+{
+    size_t pitch = size << src->log2tilewidth;
+
+    for (int brow = brow0; brow < brow1; brow++) {
+        for (int bcol = bcol0; bcol < bcol1; bcol++) {
+            int col0, row0, cols, rows;
+            const char *block = block_extent(src, bcol, brow, &col0, &row0,
+                                             &cols, &rows);
+            for (int r = 0; r < rows; r++) {
+                const char *s = block + pitch * r;
+                int y = row0 + r;
+                for (int x = col0; x < col0 + cols; x++) {
+                    int u = oriented_col(orient, x, y, src->width,
+                                         src->height);
+                    int v = oriented_row(orient, x, y, src->width,
+                                         src->height);
+                    memcpy(blocked_at(dst, u, v, size), s, size);
+                    s += size;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * morton_kernel
+ *
+ * Z-ordered source tiles col0 .. col1 - 1 of tile rows row0 .. row1 - 1
+ * into Z-ordered destination. Each tile is walked in storage order,
+ * stepping (col, row) from the trailing ones of the index as
+ * UArray2m_map does; destinations are found by interleaving.
+ */
+static ALWAYS_INLINE void morton_kernel(const struct image *src,
+                                        const struct image *dst,
+                                        Orient_T orient, size_t size,
+                                        int col0, int row0, int col1,
+                                        int row1)
+{
+    int side = 1 << src->log2side;
+    uint64_t cells = (uint64_t)side * side;
+    int across = col1 - col0;
+    size_t count = (size_t)across * (row1 - row0);
+
+    for (size_t i = 0; i < count; i++) {
+        int tcol = col0 + (int)(i % across);
+        int trow = row0 + (int)(i / across);
+        const char *s = src->base + ((size_t)trow * src->tilecols + tcol) *
+                                    cells * size;
+        int col = 0;
+        int row = 0;
+        int x0 = tcol * side;
+        int y0 = trow * side;
+
+        for (uint64_t k = 0; k < cells; k++) {
+            int x = x0 + col;
+            int y = y0 + row;
+            if (x < src->width && y < src->height) {
+                int u = oriented_col(orient, x, y, src->width, src->height);
+                int v = oriented_row(orient, x, y, src->width, src->height);
+                memcpy(dst->base + size * Morton_index(u, v, dst->log2side,
+                                                       dst->tilecols),
+                       s, size);
+            }
+            s += size;
+
+            int t = __builtin_ctzll(~k);
+            col &= ~((1 << ((t + 1) / 2)) - 1);
+            row &= ~((1 << (t / 2)) - 1);
+            if (t % 2 == 0) {
+                col |= 1 << (t / 2);
+            } else {
+                row |= 1 << (t / 2);
+            }
+        }
+    }
+}
+
+/* A tile copy with the contract of Transpose_tile1 (see transpose.h) */
+typedef void tilefun(const char *src, ptrdiff_t srcpitch, int width,
+                     int height, char *dst, ptrdiff_t dstrow, int reverse);
+
+/*
+ * engine_for
+ *
+ * The transpose engine for cells of size bytes, or NULL if it has none:
+ * it has one for the single samples of planar images and for packed
+ * pixels.
+ */
+static tilefun *engine_for(size_t size)
+{
+    switch (size) {
+    case 1:  return Transpose_tile1;
+    case 2:  return Transpose_tile2;
+    case 3:  return Transpose_tile3;
+    case 6:  return Transpose_tile6;
+    default: return NULL;
+    }
+}
+
+/*
+ * plain_transpose
+ *
+ * Transposing orientations of cells the engine knows, plain into plain:
+ * the source rectangle (col0, row0) .. (col1, row1) is one tile for the
+ * transpose engine. Source column x becomes destination row x (or
+ * height - 1 - x when flipped vertically), and source row y destination
+ * column y, laid right to left when flipped horizontally.
+ */
+static void plain_transpose(const struct image *src,
+                            const struct image *dst, Orient_T orient,
+                            int col0, int row0, int col1, int row1)
+{
+    size_t size = src->size;
+    ptrdiff_t across = (orient & ORIENT_FLIP_H) ? -(ptrdiff_t)size
+                                                : (ptrdiff_t)size;
+    ptrdiff_t dstrow = (orient & ORIENT_FLIP_V) ? -(ptrdiff_t)dst->stride
+                                                : (ptrdiff_t)dst->stride;
+    char *origin = dst->base +
+                   ((orient & ORIENT_FLIP_H) ? (dst->width - 1) * size : 0) +
+                   ((orient & ORIENT_FLIP_V) ? (dst->height - 1) * 
+                                               dst->stride : 0);
+    engine_for(size)(src->base + row0 * src->stride + col0 * size,
+                     src->stride, col1 - col0, row1 - row0,
+                     origin + row0 * across + col0 * dstrow, dstrow,
+                     orient & ORIENT_FLIP_H);
+}
+
+/*
+ * block_run
+ *
+ * How many of the cells from coordinate n onward stay in n's block of
+ * 2^shift cells, counting up (or down when descending), capped at limit.
+ */
+static inline int block_run(int n, int shift, int descending, int limit)
+{
+    int run = descending ? (n & ((1 << shift) - 1)) + 1
+                         : (1 << shift) - (n & ((1 << shift) - 1));
+    return run < limit ? run : limit;
+}
+
+/*
+ * pieces
+ *
+ * Transposing orientations of a rectangle of cells the engine knows
+ * into a blocked destination: the cols x rows rectangle at (col0, row0)
+ * of a srcwidth x srcheight source, found at src with the given pitch,
+ * is cut into the pieces that land in a single destination block, and
+ * each piece is a tile for the transpose engine.
+ */
+static void pieces(const char *src, ptrdiff_t srcpitch, int col0,
+                   int row0, int cols, int rows, int srcwidth,
+                   int srcheight, const struct image *dst,
+                   Orient_T orient)
+{
+    size_t size = dst->size;
+    tilefun *tile = engine_for(size);
+    ptrdiff_t dstpitch = ((ptrdiff_t)size) << dst->log2tilewidth;
+    int flip_h = orient & ORIENT_FLIP_H;
+    int flip_v = orient & ORIENT_FLIP_V;
+
+    /* source rows become destination columns, and vice versa */
+    for (int y = row0; y < row0 + rows; ) {
+        int u = oriented_col(orient, 0, y, srcwidth, srcheight);
+        int h = block_run(u, dst->log2tilewidth, flip_h, row0 + rows - y);
+        for (int x = col0; x < col0 + cols; ) {
+            int v = oriented_row(orient, x, 0, srcwidth, srcheight);
+            int w = block_run(v, dst->log2tileheight, flip_v,
+                              col0 + cols - x);
+            tile(src + (y - row0) * srcpitch + (x - col0) * size, srcpitch,
+                 w, h, blocked_at(dst, u, v, size),
+                 flip_v ? -dstpitch : dstpitch, flip_h);
+            x += w;
+        }
+        y += h;
+    }
+}
+
+/*
+ * blocked_transpose
+ *
+ * Transposing orientations of cells the engine knows, blocked into
+ * blocked, one source block at a time, for the source blocks in columns
+ * bcol0 .. bcol1 - 1 of block rows brow0 .. brow1 - 1.
+ */
+static void blocked_transpose(const struct image *src,
+                              const struct image *dst, Orient_T orient,
+                              int bcol0, int brow0, int bcol1, int brow1)
+{
+    ptrdiff_t srcpitch = (ptrdiff_t)src->size << src->log2tilewidth;
+
+    for (int brow = brow0; brow < brow1; brow++) {
+        for (int bcol = bcol0; bcol < bcol1; bcol++) {
+            int col0, row0, cols, rows;
+            const char *block = block_extent(src, bcol, brow, &col0, &row0,
+                                             &cols, &rows);
+            pieces(block, srcpitch, col0, row0, cols, rows, src->width,
+                   src->height, dst, orient);
+        }
+    }
+}
+
+/*
+ * A kernel copies a rectangle of the source, columns col0 .. col1 - 1 of
+ * rows row0 .. row1 - 1, counting in cells (plain), blocks (blocked), or
+ * tiles (Z-order). Rectangles are disjoint
+ * in both images, so they can be copied at once.
+ */
+typedef void kernelfun(const struct image *src, const struct image *dst,
+                       int col0, int row0, int col1, int row1);
+
+/*
+ * Instances. SIZE 0 stands for "any element size", read from the image
+ * at run time; the others are the sizes we specialize for.
+ */
+#define SIZE_OF(SIZE) ((SIZE) ? (size_t)(SIZE) : src->size)
+
+#define DEFINE_PLAIN_ROWS(ORIENT, SIZE)                                     \
+static void plain_rows_##ORIENT##_##SIZE(const struct image *src,          \
+                                         const struct image *dst,          \
+                                         int col0, int row0, int col1,     \
+                                         int row1)                         \
+{                                                                           \
+    plain_kernel(src, dst, ORIENT, SIZE_OF(SIZE), 0, col0, row0, col1,      \
+                 row1);                                                     \
+}
+#define DEFINE_PLAIN_COLS(ORIENT, SIZE)                                     \
+static void plain_cols_##ORIENT##_##SIZE(const struct image *src,          \
+                                         const struct image *dst,          \
+                                         int col0, int row0, int col1,     \
+                                         int row1)                         \
+{                                                                           \
+    plain_kernel(src, dst, ORIENT, SIZE_OF(SIZE), 1, col0, row0, col1,      \
+                 row1);                                                     \
+}
+#define DEFINE_BLOCKED(ORIENT, SIZE)                                        \
+static void blocked_##ORIENT##_##SIZE(const struct image *src,             \
+                                      const struct image *dst,             \
+                                      int col0, int row0, int col1,        \
+                                      int row1)                            \
+{                                                                           \
+    blocked_kernel(src, dst, ORIENT, SIZE_OF(SIZE), col0, row0, col1,       \
+                   row1);                                                   \
+}
+#define DEFINE_MORTON(ORIENT, SIZE)                                         \
+static void morton_##ORIENT##_##SIZE(const struct image *src,              \
+                                     const struct image *dst,              \
+                                     int col0, int row0, int col1,         \
+                                     int row1)                             \
+{                                                                           \
+    morton_kernel(src, dst, ORIENT, SIZE_OF(SIZE), col0, row0, col1,        \
+                  row1);                                                    \
+}
+
+/* One instance per non-identity orientation */
+#define INSTANCES(DEFINE, SIZE)                                             \
+    DEFINE(1, SIZE) DEFINE(2, SIZE) DEFINE(3, SIZE) DEFINE(4, SIZE)        \
+    DEFINE(5, SIZE) DEFINE(6, SIZE) DEFINE(7, SIZE)
+#define ROW(PREFIX, SIZE)                                                   \
+    { NULL, PREFIX##_1_##SIZE, PREFIX##_2_##SIZE, PREFIX##_3_##SIZE,        \
+      PREFIX##_4_##SIZE, PREFIX##_5_##SIZE, PREFIX##_6_##SIZE,              \
+      PREFIX##_7_##SIZE }
+#define ALL_INSTANCES(SIZE)                                                 \
+    INSTANCES(DEFINE_PLAIN_ROWS, SIZE)                                      \
+    INSTANCES(DEFINE_PLAIN_COLS, SIZE)                                      \
+    INSTANCES(DEFINE_BLOCKED, SIZE)                                         \
+    INSTANCES(DEFINE_MORTON, SIZE)
+#define TABLE(SIZE)                                                         \
+    { ROW(plain_rows, SIZE), ROW(plain_cols, SIZE),                         \
+      ROW(blocked, SIZE), ROW(morton, SIZE) }
+
+ALL_INSTANCES(1)        /* 8-bit samples, a plane at a time (see planar.h) */
+ALL_INSTANCES(2)        /* 16-bit samples */
+ALL_INSTANCES(3)        /* packed 8-bit pixels (see ppmio.h) */
+ALL_INSTANCES(6)        /* packed 16-bit pixels */
+ALL_INSTANCES(0)        /* anything else */
+
+/* The element sizes with instances of their own, indexing the tables */
+enum sizes { SIZE_ANY, SIZE_1, SIZE_2, SIZE_3, SIZE_6, SIZES };
+
+static kernelfun *const kernels[SIZES][LAYOUTS][ORIENT_COUNT] = {
+    TABLE(0), TABLE(1), TABLE(2), TABLE(3), TABLE(6)
+};
+
+static inline int size_class(size_t size)
+{
+    switch (size) {
+    case 1:  return SIZE_1;
+    case 2:  return SIZE_2;
+    case 3:  return SIZE_3;
+    case 6:  return SIZE_6;
+    default: return SIZE_ANY;
+    }
+}
+
+/*
+ * describe
+ *
+ * Fills in *im for array, which belongs to methods, and returns its
+ * layout, or -1 if there is no kernel for it.
+ */
+static int describe(A2Methods_T methods, A2Methods_mapfun *map,
+                    A2Methods_UArray2 array, struct image *im)
+{
+    memset(im, 0, sizeof(*im));
+    im->width = methods->width(array);
+    im->height = methods->height(array);
+    im->size = methods->size(array);
+
+    if (methods == uarray2_methods_plain) {
+        UArray2_T plain = array;
+        im->base = plain->elems;
+        im->stride = plain->stride;
+        return map == methods->map_col_major ? PLAIN_COLS : PLAIN_ROWS;
+    } else if (methods == uarray2_methods_blocked) {
+        struct UArray2b_layout layout;
+        UArray2b_get_layout(array, &layout);
+        if (layout.log2tilewidth < 0 || layout.log2tileheight < 0) {
+            return -1;
+        }
+        im->base = layout.blocks;
+        im->blockbytes = layout.blockbytes;
+        im->blockwidth = layout.blockwidth;
+        im->blockheight = layout.blockheight;
+        im->log2tilewidth = layout.log2tilewidth;
+        im->log2tileheight = layout.log2tileheight;
+        return BLOCKED;
+    } else if (methods == uarray2_methods_morton) {
+        struct UArray2m_layout layout;
+        UArray2m_get_layout(array, &layout);
+        im->base = layout.cells;
+        im->log2side = layout.log2side;
+        im->tilecols = layout.tilecols;
+        im->tilerows = layout.tilerows;
+        return MORTON;
+    }
+    return -1;
+}
+
+/*
+ * swap_cells
+ *
+ * Exchanges two cells of the given size.
+ */
+static ALWAYS_INLINE void swap_cells(char *a, char *b, size_t size)
+{
+    char tmp[64];
+    while (size > sizeof(tmp)) {
+        memcpy(tmp, a, sizeof(tmp));
+        memcpy(a, b, sizeof(tmp));
+        memcpy(b, tmp, sizeof(tmp));
+        a += sizeof(tmp);
+        b += sizeof(tmp);
+        size -= sizeof(tmp);
+    }
+    memcpy(tmp, a, size);
+    memcpy(a, b, size);
+    memcpy(b, tmp, size);
+}
+
+/*
+ * cell_at
+ *
+ * Address of (col, row) in an image of the given layout.
+ */
+static ALWAYS_INLINE char *cell_at(const struct image *im, int layout,
+                                   int col, int row, size_t size)
+{
+    if (layout == BLOCKED) {
+        return blocked_at(im, col, row, size);
+    } else if (layout == MORTON) {
+        return im->base + size * Morton_index(col, row, im->log2side,
+                                              im->tilecols);
+    }
+    return im->base + row * im->stride + col * size;
+}
+
+/*
+ * inplace_kernel
+ *
+ * Flips or turns an image by 180 degrees where it lies. Each of these
+ * orientations is its own inverse, so it is a set of disjoint swaps:
+ * every cell in the first half (the left half for a horizontal flip,
+ * the top half otherwise, plus the left half of the middle row for 180
+ * degrees on an odd height) trades places with its image. Plain images
+ * are walked a row (or row pair) at a time with pointers.
+ */
+static ALWAYS_INLINE void inplace_kernel(const struct image *im, int layout,
+                                         Orient_T orient, size_t size)
+{
+    int width = im->width;
+    int height = im->height;
+    int rows = (orient & ORIENT_FLIP_V) ? height / 2 : height;
+
+    if (layout == PLAIN_ROWS || layout == PLAIN_COLS) {
+        for (int y = 0; y < rows; y++) {
+            char *a = im->base + y * im->stride;
+            int y2 = (orient & ORIENT_FLIP_V) ? height - 1 - y : y;
+            char *b = im->base + y2 * im->stride;
+            if (orient & ORIENT_FLIP_H) {
+                int cols = (orient & ORIENT_FLIP_V) ? width : width / 2;
+                b += (width - 1) * size;
+                for (int x = 0; x < cols; x++) {
+                    swap_cells(a, b, size);
+                    a += size;
+                    b -= size;
+                }
+            } else {
+                for (int x = 0; x < width; x++) {
+                    swap_cells(a, b, size);
+                    a += size;
+                    b += size;
+                }
+            }
+        }
+    } else {
+        int cols = (orient == ORIENT_FLIP_H) ? width / 2 : width;
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < cols; x++) {
+                int u = oriented_col(orient, x, y, width, height);
+                int v = oriented_row(orient, x, y, width, height);
+                swap_cells(cell_at(im, layout, x, y, size),
+                           cell_at(im, layout, u, v, size), size);
+            }
+        }
+    }
+
+    /* 180 degrees on an odd height also reverses the middle row */
+    if (orient == ORIENT_ROT180 && height % 2 == 1) {
+        int y = height / 2;
+        for (int x = 0; x < width / 2; x++) {
+            swap_cells(cell_at(im, layout, x, y, size),
+                       cell_at(im, layout, width - 1 - x, y, size), size);
+        }
+    }
+}
+
+/*
+ * square_kernel
+ *
+ * The transposing orientations of a square plain image, in place. The
+ * 90 and 270 degree turns move the cells in layers from the outside in,
+ * four at a time: (x, y) -> (n-1-y, x) -> (n-1-x, n-1-y) -> (y, n-1-x).
+ * The transpose and the transverse are pairwise swaps across a diagonal.
+ */
+static ALWAYS_INLINE void square_kernel(const struct image *im,
+                                        Orient_T orient, size_t size)
+{
+    int n = im->width;
+
+#define SQ(X, Y) (im->base + (Y) * im->stride + (X) * size)
+    if (orient == ORIENT_ROT90 || orient == ORIENT_ROT270) {
+        for (int y = 0; y < n / 2; y++) {
+            for (int x = y; x < n - 1 - y; x++) {
+                char *p0 = SQ(x, y);
+                char *p1 = SQ(n - 1 - y, x);
+                char *p2 = SQ(n - 1 - x, n - 1 - y);
+                char *p3 = SQ(y, n - 1 - x);
+                if (orient == ORIENT_ROT90) {
+                    /* each cell moves one step along the cycle */
+                    swap_cells(p0, p3, size);
+                    swap_cells(p3, p2, size);
+                    swap_cells(p2, p1, size);
+                } else {
+                    swap_cells(p0, p1, size);
+                    swap_cells(p1, p2, size);
+                    swap_cells(p2, p3, size);
+                }
+            }
+        }
+    } else if (orient == ORIENT_TRANSPOSE) {
+        for (int y = 0; y < n; y++) {
+            for (int x = y + 1; x < n; x++) {
+                swap_cells(SQ(x, y), SQ(y, x), size);
+            }
+        }
+    } else {
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n - 1 - y; x++) {
+                swap_cells(SQ(x, y), SQ(n - 1 - y, n - 1 - x), size);
+            }
+        }
+    }
+#undef SQ
+}
+
+/*
+ * transpose_cycles
+ *
+ * Transposes, in place, a rows x cols matrix of items stored row-major,
+ * by following the cycles of the permutation: the item at index i (other
+ * than the first and last, which stay put) belongs at i * rows modulo
+ * rows * cols - 1. One item is carried around each cycle, and a bitset
+ * marks the items already placed so each cycle is followed only once.
+ * carry must have room for one item.
+ */
+static ALWAYS_INLINE void transpose_cycles(char *base, size_t rows,
+                                           size_t cols, size_t itemsize,
+                                           char *carry)
+{
+    size_t n = rows * cols;
+    if (rows <= 1 || cols <= 1) {
+        return;         /* a row and a column are stored alike */
+    }
+    unsigned char *placed = calloc((n + 7) / 8, 1);
+    assert(placed != NULL);
+
+    for (size_t start = 1; start < n - 1; start++) {
+        if (placed[start / 8] & (1 << (start % 8))) {
+            continue;
+        }
+        memcpy(carry, base + start * itemsize, itemsize);
+        size_t cur = start;
+        do {
+            size_t next = (size_t)((uint64_t)cur * rows % (n - 1));
+            swap_cells(carry, base + next * itemsize, itemsize);
+            placed[next / 8] |= 1 << (next % 8);
+            cur = next;
+        } while (cur != start);
+    }
+    free(placed);
+}
+
+/*
+ * transpose_blocks
+ *
+ * Transposes a blocked image in place: first the cells within every
+ * block (padding included), by swapping across the diagonal of a square
+ * block or following the cycles of a rectangular one, then the grid of
+ * blocks, whose items are whole blocks.
+ */
+static ALWAYS_INLINE void transpose_blocks(const struct image *im,
+                                           size_t size)
+{
+    int tw = 1 << im->log2tilewidth;
+    int th = 1 << im->log2tileheight;
+    size_t blocks = (size_t)im->blockwidth * im->blockheight;
+    char *carry = malloc(im->blockbytes);
+    assert(carry != NULL);
+
+    for (size_t b = 0; b < blocks; b++) {
+        char *block = im->base + b * im->blockbytes;
+        if (tw != th) {
+            transpose_cycles(block, th, tw, size, carry);
+            continue;
+        }
+        for (int r = 0; r < tw; r++) {
+            for (int c = r + 1; c < tw; c++) {
+                swap_cells(block + size * (r * tw + c),
+                           block + size * (c * tw + r), size);
+            }
+        }
+    }
+
+    transpose_cycles(im->base, im->blockheight, im->blockwidth,
+                     im->blockbytes, carry);
+    free(carry);
+}
+
+/*
+ * transpose_inplace
+ *
+ * Transposes a plain or blocked image where it lies. The caller then
+ * gives the array its new dimensions.
+ */
+static ALWAYS_INLINE void transpose_inplace(const struct image *im,
+                                            int layout, size_t size)
+{
+    if (layout == BLOCKED) {
+        transpose_blocks(im, size);
+    } else {
+        char carry[size];
+        transpose_cycles(im->base, im->height, im->width, size, carry);
+    }
+}
+
+/* In-place instances, one of each per element size as above */
+#define IM_SIZE(SIZE) ((SIZE) ? (size_t)(SIZE) : im->size)
+
+#define DEFINE_INPLACE(SIZE)                                                \
+static void inplace_##SIZE(const struct image *im, int layout,             \
+                           Orient_T orient)                                \
+{                                                                           \
+    inplace_kernel(im, layout, orient, IM_SIZE(SIZE));                      \
+}                                                                           \
+static void square_##SIZE(const struct image *im, Orient_T orient)         \
+{                                                                           \
+    square_kernel(im, orient, IM_SIZE(SIZE));                               \
+}                                                                           \
+static void transpose_##SIZE(const struct image *im, int layout)           \
+{                                                                           \
+    transpose_inplace(im, layout, IM_SIZE(SIZE));                           \
+}
+
+DEFINE_INPLACE(0) DEFINE_INPLACE(1) DEFINE_INPLACE(2) DEFINE_INPLACE(3)
+DEFINE_INPLACE(6)
+
+static void (*const inplaces[SIZES])(const struct image *, int, Orient_T) =
+    { inplace_0, inplace_1, inplace_2, inplace_3, inplace_6 };
+static void (*const squares[SIZES])(const struct image *, Orient_T) =
+    { square_0, square_1, square_2, square_3, square_6 };
+static void (*const transposes[SIZES])(const struct image *, int) =
+    { transpose_0, transpose_1, transpose_2, transpose_3, transpose_6 };
+
+/*
+ * Kernels_transform_inplace
+ *
+ * Applies orient to array without a second array. A transposing
+ * orientation of a square plain image is done directly; otherwise the
+ * image is transposed by following cycles and given its new dimensions,
+ * and what is left of orient - a flip, a 180 degree turn, or nothing -
+ * is done by swapping. Returns 0 (having done nothing) if there is no
+ * kernel for the layout.
+ */
+extern int Kernels_transform_inplace(A2Methods_T methods,
+                                     A2Methods_UArray2 array,
+                                     Orient_T orient)
+{
+    assert(methods != NULL);
+    assert(array != NULL);
+    assert(orient > ORIENT_IDENTITY && orient < ORIENT_COUNT);
+
+    struct image im;
+    int layout = describe(methods, NULL, array, &im);
+    if (layout < 0 || (layout == MORTON && (orient & ORIENT_TRANSPOSE))) {
+        return 0;
+    }
+
+    if (orient & ORIENT_TRANSPOSE) {
+        if (layout != BLOCKED && im.width == im.height) {
+            squares[size_class(im.size)](&im, orient);
+            return 1;
+        }
+
+        transposes[size_class(im.size)](&im, layout);
+        if (layout == BLOCKED) {
+            UArray2b_swap_dimensions(array);
+        } else {
+            UArray2_reshape(array, im.height, im.width);
+        }
+
+        orient &= ~ORIENT_TRANSPOSE;
+        if (orient == ORIENT_IDENTITY) {
+            return 1;
+        }
+        describe(methods, NULL, array, &im);
+    }
+
+    inplaces[size_class(im.size)](&im, layout, orient);
+    return 1;
+}
+
+/*
+ * Bytes of source a leaf of parallel work may cover, so that it and its
+ * destination fit together in a core's L2 cache
+ */
+#define REGION (256 << 10)
+
+/* A copy of the whole image, as rectangles of parts for Pool_run_tiles */
+struct job {
+    kernelfun *kernel;          /* or NULL for the transpose engine */
+    const struct image *src;
+    const struct image *dst;
+    int layout;
+    Orient_T orient;
+};
+
+/*
+ * run_job
+ *
+ * Copies a rectangle of parts: TILE x TILE tiles of cells (plain),
+ * blocks (blocked), or tiles (Z-order).
+ */
+static void run_job(int col0, int row0, int col1, int row1, void *cl)
+{
+    const struct job *job = cl;
+    const struct image *src = job->src;
+    if (job->layout == PLAIN_ROWS || job->layout == PLAIN_COLS) {
+        col0 *= TILE;
+        row0 *= TILE;
+        col1 = col1 * TILE < src->width ? col1 * TILE : src->width;
+        row1 = row1 * TILE < src->height ? row1 * TILE : src->height;
+    }
+    if (job->kernel != NULL) {
+        job->kernel(src, job->dst, col0, row0, col1, row1);
+    } else if (job->layout == PLAIN_ROWS) {
+        plain_transpose(src, job->dst, job->orient, col0, row0, col1, row1);
+    } else {
+        blocked_transpose(src, job->dst, job->orient, col0, row0, col1,
+                          row1);
+    }
+}
+
+/*
+ * Kernels_transform
+ *
+ * Copies src into dst under orient with the kernel for their layout and
+ * element size, chosen once here, and on the default pool if map is a
+ * parallel one: the pool splits the image into rectangles of parts of
+ * about REGION bytes, so each thread works through neighbouring regions
+ * of both images. Returns 0 (having done nothing) if there is no such
+ * kernel.
+ */
+extern int Kernels_transform(A2Methods_T methods, A2Methods_mapfun *map,
+                             A2Methods_UArray2 src, A2Methods_UArray2 dst,
+                             Orient_T orient)
+{
+    assert(methods != NULL);
+    assert(src != NULL && dst != NULL);
+    assert(orient > ORIENT_IDENTITY && orient < ORIENT_COUNT);
+
+    struct image from, to;
+    int layout = describe(methods, map, src, &from);
+    if (layout < 0 || describe(methods, map, dst, &to) != layout) {
+        return 0;
+    }
+    assert(to.size == from.size);
+    assert(to.width == ((orient & ORIENT_TRANSPOSE) ? from.height 
+                                                   : from.width));
+    assert(to.height == ((orient & ORIENT_TRANSPOSE) ? from.width 
+                                                    : from.height));
+    if (from.width == 0 || from.height == 0) {
+        return 1;
+    }
+
+    struct job job = { kernels[size_class(from.size)][layout][orient],
+                       &from, &to, layout, orient };
+
+    /* 90, 270, and the transposes go to the engine if it knows the size */
+    if (engine_for(from.size) != NULL && (orient & ORIENT_TRANSPOSE) &&
+        (layout == PLAIN_ROWS || layout == BLOCKED)) {
+        job.kernel = NULL;
+    }
+
+    int cols = (from.width + TILE - 1) / TILE;
+    int rows = (from.height + TILE - 1) / TILE;
+    size_t partbytes = (size_t)TILE * TILE * from.size;
+    if (layout == BLOCKED) {
+        cols = from.blockwidth;
+        rows = from.blockheight;
+        partbytes = from.blockbytes;
+    } else if (layout == MORTON) {
+        cols = from.tilecols;
+        rows = from.tilerows;
+        partbytes = ((size_t)1 << (2 * from.log2side)) * from.size;
+    }
+    long leaf = partbytes < REGION ? REGION / partbytes : 1;
+    int parallel = map != NULL && (map == methods->map_row_major_parallel ||
+                                   map == methods->map_block_major_parallel);
+    Pool_run_tiles(parallel ? Pool_default() : NULL, cols, rows, leaf,
+                   run_job, &job);
+    return 1;
+}
+
+/*
+ * gather_kernel
+ *
+ * The rectangle at (col, row) of the oriented image, into buf. Cell
+ * (u, v) comes from (x, y) = the inverse of orient applied to it; the
+ * loops run so that x, which walks along a source row, varies fastest:
+ * down the output columns when transposing, along the output rows
+ * otherwise. Source rows that are kept whole and in order are copied
+ * with one memcpy, or one per block they cross.
+ */
+static ALWAYS_INLINE void gather_kernel(const struct image *im, int layout,
+                                        Orient_T orient, size_t size,
+                                        int col, int row, int width,
+                                        int height, char *buf)
+{
+    int transposed = orient & ORIENT_TRANSPOSE;
+    int fullwidth = transposed ? im->height : im->width;
+    int fullheight = transposed ? im->width : im->height;
+    size_t pitch = (size_t)width * size;
+
+    for (int outer = 0; outer < (transposed ? width : height); outer++) {
+        int y;
+        if (transposed) {
+            int u = col + outer;
+            y = (orient & ORIENT_FLIP_H) ? fullwidth - 1 - u : u;
+        } else {
+            int v = row + outer;
+            y = (orient & ORIENT_FLIP_V) ? fullheight - 1 - v : v;
+        }
+        if (layout == PLAIN_ROWS && !transposed &&
+            !(orient & ORIENT_FLIP_H)) {
+            memcpy(buf + outer * pitch, cell_at(im, layout, col, y, size),
+                   pitch);
+            continue;
+        }
+        if (layout == BLOCKED && !transposed && !(orient & ORIENT_FLIP_H)) {
+            int tw = 1 << im->log2tilewidth;
+            char *d = buf + outer * pitch;
+            for (int x = col, run; x < col + width; x += run) {
+                run = tw - (x & (tw - 1));
+                run = run < col + width - x ? run : col + width - x;
+                memcpy(d, cell_at(im, layout, x, y, size), run * size);
+                d += run * size;
+            }
+            continue;
+        }
+        for (int inner = 0; inner < (transposed ? height : width); inner++) {
+            char *d;
+            int x;
+            if (transposed) {
+                int v = row + inner;
+                x = (orient & ORIENT_FLIP_V) ? fullheight - 1 - v : v;
+                d = buf + inner * pitch + outer * size;
+            } else {
+                int u = col + inner;
+                x = (orient & ORIENT_FLIP_H) ? fullwidth - 1 - u : u;
+                d = buf + outer * pitch + inner * size;
+            }
+            memcpy(d, cell_at(im, layout, x, y, size), size);
+        }
+    }
+}
+
+/*
+ * plain_gather
+ *
+ * Transposing orientations of cells the engine knows from a plain
+ * image: the source rectangle the output comes from is one tile for the
+ * transpose engine, as in plain_transpose. Output rows row .. row +
+ * height - 1 are source columns x0 ..; output columns col .. are source
+ * rows y0 ..
+ */
+static void plain_gather(const struct image *im, Orient_T orient,
+                         int col, int row, int width, int height,
+                         char *buf)
+{
+    size_t size = im->size;
+    ptrdiff_t pitch = (ptrdiff_t)width * size;
+    int x0 = (orient & ORIENT_FLIP_V) ? im->width - row - height : row;
+    int y0 = (orient & ORIENT_FLIP_H) ? im->height - col - width : col;
+    char *origin = buf +
+                   ((orient & ORIENT_FLIP_V) ? (height - 1) * pitch : 0) +
+                   ((orient & ORIENT_FLIP_H) ? (width - 1) * size : 0);
+    engine_for(size)(im->base + y0 * im->stride + x0 * size, im->stride,
+                     height, width, origin,
+                     (orient & ORIENT_FLIP_V) ? -pitch : pitch,
+                     orient & ORIENT_FLIP_H);
+}
+
+#define DEFINE_GATHER(SIZE)                                                 \
+static void gather_##SIZE(const struct image *im, int layout,              \
+                          Orient_T orient, int col, int row, int width,    \
+                          int height, char *buf)                           \
+{                                                                           \
+    gather_kernel(im, layout, orient, IM_SIZE(SIZE), col, row, width,       \
+                  height, buf);                                             \
+}
+
+DEFINE_GATHER(0) DEFINE_GATHER(1) DEFINE_GATHER(2) DEFINE_GATHER(3)
+DEFINE_GATHER(6)
+
+static void (*const gathers[SIZES])(const struct image *, int, Orient_T,
+                                    int, int, int, int, char *) =
+    { gather_0, gather_1, gather_2, gather_3, gather_6 };
+
+/*
+ * Kernels_gather
+ *
+ * Reads a rectangle of the oriented image with the gather for the
+ * array's layout. Returns 0 (having done nothing) if there is none.
+ */
+extern int Kernels_gather(A2Methods_T methods, A2Methods_UArray2 array,
+                          Orient_T orient, int col, int row, int width,
+                          int height, void *buf)
+{
+    assert(methods != NULL);
+    assert(array != NULL);
+    assert(orient >= ORIENT_IDENTITY && orient < ORIENT_COUNT);
+
+    struct image im;
+    int layout = describe(methods, NULL, array, &im);
+    if (layout < 0) {
+        return 0;
+    }
+    int transposed = orient & ORIENT_TRANSPOSE;
+    assert(col >= 0 && row >= 0 && width >= 0 && height >= 0);
+    assert(col + width <= (transposed ? im.height : im.width));
+    assert(row + height <= (transposed ? im.width : im.height));
+    if (width == 0 || height == 0) {
+        return 1;
+    }
+
+    if (engine_for(im.size) != NULL && transposed && layout == PLAIN_ROWS) {
+        plain_gather(&im, orient, col, row, width, height, buf);
+    } else {
+        gathers[size_class(im.size)](&im, layout, orient, col, row, width,
+                                     height, buf);
+    }
+    return 1;
+}
+
+/*
+ * scatter_kernel
+ *
+ * The rectangle of the source image held in buf, into the oriented
+ * image im at the places orient sends it: the reverse of gather_kernel.
+ * buf is read in order; source rows kept whole and in order go to a
+ * plain image with one memcpy.
+ */
+static ALWAYS_INLINE void scatter_kernel(const struct image *im, int layout,
+                                         Orient_T orient, size_t size,
+                                         int col, int row, int width,
+                                         int height, const char *buf)
+{
+    int transposed = orient & ORIENT_TRANSPOSE;
+    int srcwidth = transposed ? im->height : im->width;
+    int srcheight = transposed ? im->width : im->height;
+    size_t pitch = (size_t)width * size;
+
+    for (int y = row; y < row + height; y++) {
+        const char *s = buf + (y - row) * pitch;
+        if (layout == PLAIN_ROWS && !transposed &&
+            !(orient & ORIENT_FLIP_H)) {
+            int v = oriented_row(orient, col, y, srcwidth, srcheight);
+            memcpy(cell_at(im, layout, col, v, size), s, pitch);
+            continue;
+        }
+        for (int x = col; x < col + width; x++) {
+            int u = oriented_col(orient, x, y, srcwidth, srcheight);
+            int v = oriented_row(orient, x, y, srcwidth, srcheight);
+            memcpy(cell_at(im, layout, u, v, size), s, size);
+            s += size;
+        }
+    }
+}
+
+/*
+ * plain_scatter
+ *
+ * Transposing orientations of cells the engine knows into a plain
+ * image: buf is one tile for the transpose engine. Source column x
+ * becomes destination row x (or srcwidth - 1 - x), and source row y
+ * destination column y (or srcheight - 1 - y), as in plain_transpose.
+ */
+static void plain_scatter(const struct image *im, Orient_T orient,
+                          int col, int row, int width, int height,
+                          const char *buf)
+{
+    size_t size = im->size;
+    int u = oriented_col(orient, 0, row, im->height, im->width);
+    int v = oriented_row(orient, col, 0, im->height, im->width);
+    ptrdiff_t dstrow = (orient & ORIENT_FLIP_V) ? -(ptrdiff_t)im->stride
+                                                : (ptrdiff_t)im->stride;
+    engine_for(size)(buf, (ptrdiff_t)width * size, width, height,
+                     im->base + v * im->stride + u * size, dstrow,
+                     orient & ORIENT_FLIP_H);
+}
+
+#define DEFINE_SCATTER(SIZE)                                                \
+static void scatter_##SIZE(const struct image *im, int layout,             \
+                           Orient_T orient, int col, int row, int width,   \
+                           int height, const char *buf)                    \
+{                                                                           \
+    scatter_kernel(im, layout, orient, IM_SIZE(SIZE), col, row, width,      \
+                   height, buf);                                            \
+}
+
+DEFINE_SCATTER(0) DEFINE_SCATTER(1) DEFINE_SCATTER(2) DEFINE_SCATTER(3)
+DEFINE_SCATTER(6)
+
+static void (*const scatters[SIZES])(const struct image *, int, Orient_T,
+                                     int, int, int, int, const char *) =
+    { scatter_0, scatter_1, scatter_2, scatter_3, scatter_6 };
+
+/*
+ * Kernels_scatter
+ *
+ * Writes a rectangle of the source image into the oriented array with
+ * the scatter for the array's layout. The transposing orientations of
+ * cells the engine knows go to it. Returns 0 (having done nothing) if
+ * there is no kernel.
+ */
+extern int Kernels_scatter(A2Methods_T methods, A2Methods_UArray2 array,
+                           Orient_T orient, int col, int row, int width,
+                           int height, const void *buf)
+{
+    assert(methods != NULL);
+    assert(array != NULL);
+    assert(orient >= ORIENT_IDENTITY && orient < ORIENT_COUNT);
+
+    struct image im;
+    int layout = describe(methods, NULL, array, &im);
+    if (layout < 0) {
+        return 0;
+    }
+    int transposed = orient & ORIENT_TRANSPOSE;
+    assert(col >= 0 && row >= 0 && width >= 0 && height >= 0);
+    assert(col + width <= (transposed ? im.height : im.width));
+    assert(row + height <= (transposed ? im.width : im.height));
+    if (width == 0 || height == 0) {
+        return 1;
+    }
+
+    int engine = engine_for(im.size) != NULL;
+    if (engine && transposed && layout == PLAIN_ROWS) {
+        plain_scatter(&im, orient, col, row, width, height, buf);
+    } else if (engine && transposed && layout == BLOCKED) {
+        pieces(buf, (ptrdiff_t)width * im.size, col, row, width, height,
+               im.height, im.width, &im, orient);
+    } else {
+        scatters[size_class(im.size)](&im, layout, orient, col, row, width,
+                                      height, buf);
+    }
+    return 1;
+}
+
+/*
+ * Kernels_storage
+ *
+ * The slab behind an array of a layout with kernels, found as describe
+ * finds everything else: the rows of a plain array, every block of a
+ * blocked one (clipped edges included), or every tile of a Z-order one.
+ */
+extern int Kernels_storage(A2Methods_T methods, A2Methods_UArray2 array,
+                           void **base, size_t *bytes)
+{
+    assert(methods != NULL);
+    assert(array != NULL);
+    assert(base != NULL && bytes != NULL);
+
+    struct image im;
+    int layout = describe(methods, NULL, array, &im);
+    if (layout < 0) {
+        return 0;
+    }
+    *base = im.base;
+    if (layout == BLOCKED) {
+        *bytes = im.blockbytes * im.blockwidth * im.blockheight;
+    } else if (layout == MORTON) {
+        *bytes = ((size_t)im.tilecols * im.tilerows << (2 * im.log2side)) *
+                 im.size;
+    } else {
+        *bytes = im.stride * im.height;
+    }
+    return 1;
+}
@@ -0,0 +1,127 @@
+/*
+ * kernels.h
+ *
+ * Interface to the transform kernels: straight-line loops that copy an
+ * image into a new array under an orientation (see orient.h) without
+ * going through A2Methods function pointers.
+ *
+ * There is one kernel per (orientation x storage layout x element size),
+ * with the sizes of single samples (1 and 2 bytes; see planar.h), of
+ * packed 8- and 16-bit pixels (3 and 6 bytes; see ppmio.h) specialized,
+ * and one for the rest.
+ * Each walks the source in storage order and computes destination
+ * addresses directly, with no per-pixel asserts or indirect calls.
+ * Kernels_transform picks the kernel once per image.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef KERNELS_INCLUDED
+#define KERNELS_INCLUDED
+
+#include <stddef.h>
+
+#include "a2methods.h"
+#include "orient.h"
+
+/*
+ * Kernels_transform
+ * 
+ * Copies every cell of src into dst under orient, so that cell (i, j) of
+ * src lands at its oriented position in dst.
+ * 
+ * Parameters: the methods suite both arrays belong to, the map the
+ *             caller would otherwise walk src with (this picks the
+ *             traversal order for the plain suite, and a parallel map
+ *             spreads the copy over the default pool; see pool.h), the
+ *             source and destination arrays, and the orientation.
+ * 
+ * Returns: 1 if a kernel did the copy; 0 if there is none for this suite
+ *          or geometry, in which case nothing was written and the caller
+ *          should fall back to mapping with an apply function.
+ * 
+ * Expectations: dst has the oriented dimensions of src and the same
+ *               element size.
+ */
+extern int Kernels_transform(A2Methods_T methods, A2Methods_mapfun *map,
+                             A2Methods_UArray2 src, A2Methods_UArray2 dst,
+                             Orient_T orient);
+
+/*
+ * Kernels_transform_inplace
+ * 
+ * Applies orient to array where it lies, so no second array is needed.
+ * Flips and the 180 degree turn are done by swapping cells. The
+ * transposing orientations (90, 270, and the transposes) are done by
+ * layered swaps for square plain images, and by cycle-following in the
+ * plain or blocked slab otherwise, after which the array has the
+ * transposed dimensions. That is slower than copying, but needs memory
+ * for only one image (plus one bit per cell).
+ * 
+ * Returns: 1 if the array was transformed; 0 if there is no kernel for
+ *          the suite (or, for Z-order, for a transposing orientation),
+ *          in which case the array is untouched.
+ */
+extern int Kernels_transform_inplace(A2Methods_T methods,
+                                     A2Methods_UArray2 array,
+                                     Orient_T orient);
+
+/*
+ * Kernels_gather
+ * 
+ * Copies the width x height rectangle at (col, row) of the image that
+ * array would become under orient into buf, row by row, without
+ * transforming array. This is how a view (see a2view.h) is read: the
+ * array is walked in its own storage order as far as the rectangle
+ * allows, so a band of output rows costs one streaming pass over the
+ * part of the array it comes from.
+ * 
+ * Parameters: the methods suite of array, the array, the orientation,
+ *             the rectangle in oriented coordinates, and a buffer of
+ *             width * height cells.
+ * 
+ * Returns: 1 if a kernel did the copy; 0 if there is none for the suite,
+ *          in which case nothing was written.
+ * 
+ * Expectations: the rectangle lies within the oriented image.
+ */
+extern int Kernels_gather(A2Methods_T methods, A2Methods_UArray2 array,
+                          Orient_T orient, int col, int row, int width,
+                          int height, void *buf);
+
+/*
+ * Kernels_scatter
+ * 
+ * The reverse of Kernels_gather: copies a width x height rectangle of a
+ * source image, held row by row in buf, into array at the places orient
+ * sends it, where array holds the oriented image. This is how an image
+ * is transformed as it is read: each band of decoded rows goes straight
+ * to its final position.
+ * 
+ * Parameters: the methods suite of array, the (oriented) array, the
+ *             orientation, the rectangle at (col, row) in source
+ *             coordinates, and the buffer holding it.
+ * 
+ * Returns: 1 if a kernel did the copy; 0 if there is none for the suite,
+ *          in which case nothing was written.
+ * 
+ * Expectations: the rectangle lies within the source image, which is
+ *               array's dimensions swapped if orient transposes.
+ */
+extern int Kernels_scatter(A2Methods_T methods, A2Methods_UArray2 array,
+                           Orient_T orient, int col, int row, int width,
+                           int height, const void *buf);
+
+/*
+ * Kernels_storage
+ * 
+ * Finds the memory holding array's cells, for reporting where it lies
+ * (see numa.h).
+ * 
+ * Returns: 1, with the address and size stored in *base and *bytes, if
+ *          there are kernels for array's suite; otherwise 0.
+ */
+extern int Kernels_storage(A2Methods_T methods, A2Methods_UArray2 array,
+                           void **base, size_t *bytes);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * morton.h
+ *
+ * Bit-interleaving helpers for the Z-order (Morton) layout used by
+ * UArray2m. They are inline so that UArray2m_at and the transform
+ * kernels can compute Z-order addresses without a call.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef MORTON_INCLUDED
+#define MORTON_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+/* Morton_spread_byte[b]: the bits of b moved to the even bit positions */
+extern const uint16_t Morton_spread_byte[256];
+
+/*
+ * Morton_spread
+ * 
+ * Moves bit i of x to bit 2i of the result. Uses pdep where the
+ * compiler targets BMI2, and four table lookups otherwise.
+ */
+static inline uint64_t Morton_spread(uint32_t x)
+{
+#ifdef __BMI2__
+    return _pdep_u64(x, 0x5555555555555555ULL);
+#else
+    return (uint64_t)Morton_spread_byte[x & 0xff] |
+           (uint64_t)Morton_spread_byte[(x >> 8) & 0xff] << 16 |
+           (uint64_t)Morton_spread_byte[(x >> 16) & 0xff] << 32 |
+           (uint64_t)Morton_spread_byte[x >> 24] << 48;
+#endif
+}
+
+/*
+ * Morton_index
+ * 
+ * Returns the cell index of (col, row) in a Z-ordered slab whose square
+ * tiles are 2^log2side on a side and are stored a row of tilecols tiles
+ * at a time.
+ */
+static inline uint64_t Morton_index(int col, int row, int log2side,
+                                    int tilecols)
+{
+    uint32_t mask = ((uint32_t)1 << log2side) - 1;
+    uint64_t tile = (uint64_t)((uint32_t)row >> log2side) * tilecols +
+                    ((uint32_t)col >> log2side);
+    return (tile << (2 * log2side)) | 
+           Morton_spread((uint32_t)col & mask) | 
+           Morton_spread((uint32_t)row & mask) << 1;
+}
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * numa.c
+ *
+ * Implementation file for the NUMA layout.
+ *
+ * The nodes with CPUs are listed in /sys/devices/system/node/has_cpu,
+ * and the CPUs of node n in .../noden/cpulist, both as lists of ranges
+ * like "0-15,32-47". Pages are located with move_pages, which with no
+ * target nodes moves nothing and reports where each page is.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#define _GNU_SOURCE /* for pthread_setaffinity_np */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "numa.h"
+
+#define NODES 64       /* nodes we keep track of */
+#define PAGE 4096
+#define BATCH 1024     /* pages asked about per call */
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static int nodes = 1;
+static int ids[NODES];                 /* the kernel's number for each */
+static cpu_set_t cpus[NODES];
+static int known[NODES];               /* cpus[i] was read */
+
+/*
+ * read_list
+ *
+ * Reads a list of ranges from the file at path, calling add on every
+ * number in it. Returns 0 if the file could not be read.
+ */
+static int read_list(const char *path, void add(int n, void *cl), void *cl)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    int lo, hi;
+    int ok = 0;
+    while (fscanf(fp, "%d", &lo) == 1) {
+        hi = lo;
+        int c = fgetc(fp);
+        if (c == '-') {
+            if (fscanf(fp, "%d", &hi) != 1) {
+                break;
+            }
+            c = fgetc(fp);
+        }
+        for (int n = lo; n <= hi; n++) {
+            add(n, cl);
+        }
+        ok = 1;
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(fp);
+    return ok;
+}
+
+static void add_node(int n, void *cl)
+{
+    int *count = cl;
+    if (*count < NODES) {
+        ids[(*count)++] = n;
+    }
+}
+
+static void add_cpu(int n, void *cl)
+{
+    if (n < CPU_SETSIZE) {
+        CPU_SET(n, (cpu_set_t *)cl);
+    }
+}
+
+static void discover(void)
+{
+    int count = 0;
+    if (!read_list("/sys/devices/system/node/has_cpu", add_node, &count) ||
+        count == 0) {
+        ids[0] = 0;
+        count = 1;
+    }
+    nodes = count;
+    for (int i = 0; i < nodes; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/"
+                 "cpulist", ids[i]);
+        CPU_ZERO(&cpus[i]);
+        known[i] = read_list(path, add_cpu, &cpus[i]);
+    }
+}
+
+extern int Numa_nodes(void)
+{
+    pthread_once(&once, discover);
+    return nodes;
+}
+
+extern int Numa_bind(pthread_t thread, int node)
+{
+    assert(node >= 0 && node < Numa_nodes());
+    if (!known[node]) {
+        return 0;
+    }
+    return pthread_setaffinity_np(thread, sizeof(cpus[node]),
+                                  &cpus[node]) == 0;
+}
+
+extern void Numa_where(const void *addr, size_t bytes, long *counts)
+{
+    int n = Numa_nodes();
+    for (int i = 0; i <= n; i++) {
+        counts[i] = 0;
+    }
+    if (bytes == 0) {
+        return;
+    }
+
+    uintptr_t first = (uintptr_t)addr & ~(uintptr_t)(PAGE - 1);
+    uintptr_t end = (uintptr_t)addr + bytes;
+    void *pages[BATCH];
+    int status[BATCH];
+    for (uintptr_t page = first; page < end; ) {
+        int count = 0;
+        for (; count < BATCH && page < end; count++, page += PAGE) {
+            pages[count] = (void *)page;
+        }
+        if (syscall(SYS_move_pages, 0, (unsigned long)count, pages, NULL,
+                    status, 0) != 0) {
+            counts[n] += count;
+            continue;
+        }
+        for (int k = 0; k < count; k++) {
+            int i = 0;
+            while (i < n && ids[i] != status[k]) {
+                i++;
+            }
+            counts[i]++;
+        }
+    }
+}
+
+extern void Numa_report(FILE *fp, const char *label, const void *addr,
+                        size_t bytes)
+{
+    assert(fp != NULL && label != NULL);
+    int n = Numa_nodes();
+    long counts[NODES + 1];
+    long total = 0;
+    Numa_where(addr, bytes, counts);
+    for (int i = 0; i <= n; i++) {
+        total += counts[i];
+    }
+
+    fprintf(fp, "%s: %ld pages", label, total);
+    for (int i = 0; i < n && total > 0; i++) {
+        fprintf(fp, ", node %d %.1f%%", ids[i], 100.0 * counts[i] / total);
+    }
+    if (counts[n] > 0) {
+        fprintf(fp, ", untouched or unknown %.1f%%",
+                100.0 * counts[n] / total);
+    }
+    fprintf(fp, "\n");
+}
@@ -0,0 +1,61 @@
+/*
+ * numa.h
+ *
+ * Interface to what we need of the machine's NUMA layout: how many
+ * nodes have CPUs, pinning a thread to the CPUs of one, and finding out
+ * which nodes the pages of a range of memory live on. It reads the
+ * layout from /sys and asks the kernel directly, so it needs no
+ * libnuma; on a machine (or kernel) without NUMA there is one node.
+ *
+ * Nodes are numbered 0 .. Numa_nodes() - 1 here, which need not be the
+ * kernel's numbering; Numa_report prints the kernel's.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef NUMA_INCLUDED
+#define NUMA_INCLUDED
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Numa_nodes
+ *
+ * The number of nodes with CPUs, at least 1.
+ */
+extern int  Numa_nodes(void);
+
+/*
+ * Numa_bind
+ *
+ * Restricts thread to the CPUs of node, so that the memory it touches
+ * first is placed there. Returns 1 if it did, 0 if the CPUs are not
+ * known or the kernel refused.
+ *
+ * Expectations: 0 <= node < Numa_nodes() (CRE).
+ */
+extern int  Numa_bind(pthread_t thread, int node);
+
+/*
+ * Numa_where
+ *
+ * Counts the pages of the bytes at addr that are on each node, in
+ * counts[0 .. Numa_nodes() - 1], and those not yet touched (or whose
+ * node the kernel will not tell) in counts[Numa_nodes()].
+ *
+ * Expectations: counts has room for Numa_nodes() + 1 (not checked).
+ */
+extern void Numa_where(const void *addr, size_t bytes, long *counts);
+
+/*
+ * Numa_report
+ *
+ * Writes a line to fp giving label and the share of the pages of the
+ * bytes at addr on each node, as found by Numa_where.
+ */
+extern void Numa_report(FILE *fp, const char *label, const void *addr,
+                        size_t bytes);
+
+#endif
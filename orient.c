@@ -0,0 +1,152 @@
+/*
+ * orient.c
+ *
+ * Composition of orientations.
+ *
+ * Measured from the centre of the image, every orientation is linear: a
+ * transpose swaps the two coordinates and a flip negates one. So each
+ * orientation is a 2 x 2 matrix with one nonzero entry (+1 or -1) per
+ * row and column, composing orientations is multiplying matrices, and
+ * the three bits can be read back off the product.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#include <stddef.h>
+
+#include "assert.h"
+#include "orient.h"
+
+struct matrix {
+    int m[2][2];
+};
+
+/*
+ * to_matrix
+ * 
+ * diag(flip_h ? -1 : 1, flip_v ? -1 : 1), times the swap if transposing.
+ */
+static struct matrix to_matrix(Orient_T orient)
+{
+    int h = (orient & ORIENT_FLIP_H) ? -1 : 1;
+    int v = (orient & ORIENT_FLIP_V) ? -1 : 1;
+    struct matrix a = {{{0, 0}, {0, 0}}};
+    if (orient & ORIENT_TRANSPOSE) {
+        a.m[0][1] = h;
+        a.m[1][0] = v;
+    } else {
+        a.m[0][0] = h;
+        a.m[1][1] = v;
+    }
+    return a;
+}
+
+/*
+ * from_matrix
+ * 
+ * The inverse of to_matrix.
+ */
+static Orient_T from_matrix(struct matrix a)
+{
+    Orient_T orient = ORIENT_IDENTITY;
+    int h, v;
+    if (a.m[0][0] == 0) {
+        orient |= ORIENT_TRANSPOSE;
+        h = a.m[0][1];
+        v = a.m[1][0];
+    } else {
+        h = a.m[0][0];
+        v = a.m[1][1];
+    }
+    if (h < 0) {
+        orient |= ORIENT_FLIP_H;
+    }
+    if (v < 0) {
+        orient |= ORIENT_FLIP_V;
+    }
+    return orient;
+}
+
+/*
+ * Orient_compose
+ * 
+ * Applying first and then then is the matrix product then * first.
+ */
+extern Orient_T Orient_compose(Orient_T first, Orient_T then)
+{
+    assert(first >= 0 && first < ORIENT_COUNT);
+    assert(then >= 0 && then < ORIENT_COUNT);
+
+    struct matrix a = to_matrix(then);
+    struct matrix b = to_matrix(first);
+    struct matrix product;
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            product.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j];
+        }
+    }
+    return from_matrix(product);
+}
+
+/*
+ * Orient_rotation
+ * 
+ * The orientation for a clockwise rotation by 0, 90, 180, or 270 degrees.
+ */
+extern Orient_T Orient_rotation(int degrees)
+{
+    switch (degrees) {
+    case 0:
+        return ORIENT_IDENTITY;
+    case 90:
+        return ORIENT_ROT90;
+    case 180:
+        return ORIENT_ROT180;
+    case 270:
+        return ORIENT_ROT270;
+    }
+    assert(0);
+    return ORIENT_IDENTITY;
+}
+
+/*
+ * Orient_inverse
+ * 
+ * A flip undoes itself; under a transpose the flips trade places, since
+ * the inverse flips first and transposes after.
+ */
+extern Orient_T Orient_inverse(Orient_T orient)
+{
+    assert(orient >= 0 && orient < ORIENT_COUNT);
+
+    if (!(orient & ORIENT_TRANSPOSE)) {
+        return orient;
+    }
+    return ORIENT_TRANSPOSE |
+           ((orient & ORIENT_FLIP_H) ? ORIENT_FLIP_V : 0) |
+           ((orient & ORIENT_FLIP_V) ? ORIENT_FLIP_H : 0);
+}
+
+/*
+ * Orient_apply
+ * 
+ * Transpose, then mirror across the dimensions of the result.
+ */
+extern void Orient_apply(Orient_T orient, int width, int height,
+                         int *col, int *row)
+{
+    assert(orient >= 0 && orient < ORIENT_COUNT);
+    assert(col != NULL && row != NULL);
+
+    int u = *col;
+    int v = *row;
+    if (orient & ORIENT_TRANSPOSE) {
+        u = *row;
+        v = *col;
+        int w = width;
+        width = height;
+        height = w;
+    }
+    *col = (orient & ORIENT_FLIP_H) ? width - 1 - u : u;
+    *row = (orient & ORIENT_FLIP_V) ? height - 1 - v : v;
+}
@@ -0,0 +1,70 @@
+/*
+ * orient.h
+ *
+ * Orientations: the eight ways of laying a rectangular image back down
+ * on itself (the rotations, flips, and transposes ppmtrans performs).
+ *
+ * An orientation is three bits. Applied to a cell (col, row), it first
+ * swaps col and row if ORIENT_TRANSPOSE is set, then mirrors the column
+ * across the width of the result if ORIENT_FLIP_H is set, then mirrors
+ * the row across its height if ORIENT_FLIP_V is set.
+ *
+ * The orientations form a group (the dihedral group of order 8), so any
+ * sequence of rotations, flips, and transposes is itself one of them;
+ * Orient_compose reduces a sequence one step at a time.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef ORIENT_INCLUDED
+#define ORIENT_INCLUDED
+
+typedef int Orient_T;
+
+#define ORIENT_TRANSPOSE 1
+#define ORIENT_FLIP_H    2
+#define ORIENT_FLIP_V    4
+
+#define ORIENT_IDENTITY   0
+#define ORIENT_ROT90      (ORIENT_TRANSPOSE | ORIENT_FLIP_H)
+#define ORIENT_ROT180     (ORIENT_FLIP_H | ORIENT_FLIP_V)
+#define ORIENT_ROT270     (ORIENT_TRANSPOSE | ORIENT_FLIP_V)
+#define ORIENT_TRANSVERSE (ORIENT_TRANSPOSE | ORIENT_FLIP_H | ORIENT_FLIP_V)
+
+#define ORIENT_COUNT 8
+
+/*
+ * Orient_compose
+ * 
+ * Returns the single orientation that has the effect of applying first
+ * and then then.
+ */
+extern Orient_T Orient_compose(Orient_T first, Orient_T then);
+
+/*
+ * Orient_rotation
+ * 
+ * Returns the orientation for a clockwise rotation by degrees, which
+ * must be 0, 90, 180, or 270 (a CRE otherwise).
+ */
+extern Orient_T Orient_rotation(int degrees);
+
+/*
+ * Orient_inverse
+ * 
+ * Returns the orientation that undoes orient.
+ */
+extern Orient_T Orient_inverse(Orient_T orient);
+
+/*
+ * Orient_apply
+ * 
+ * Moves the cell at (*col, *row) of a width x height image to where
+ * orient puts it.
+ * 
+ * Expectations: col and row are not NULL and the cell is in bounds.
+ */
+extern void Orient_apply(Orient_T orient, int width, int height,
+                         int *col, int *row);
+
+#endif
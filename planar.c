@@ -0,0 +1,157 @@
+/*
+ * planar.c
+ *
+ * Implementation file for planar images.
+ *
+ * It is a checked run-time error to pass a NULL T to any function in this
+ * interface.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#include "planar.h"
+#include "kernels.h"
+#include "assert.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define T Planar_T
+
+struct T {
+    A2Methods_T methods;
+    int width;
+    int height;
+    int size;
+    A2Methods_UArray2 planes[PLANAR_PLANES];
+};
+
+/*
+ * Planar_new
+ *
+ * Creates a new planar image
+ *
+ * Parameters: the suite for the planes, the width and height of the
+ *             image, and the size of a sample.
+ *
+ * Returns: a Planar object
+ *
+ * Expectations: methods is not NULL and size is 1 or 2 (CREs); width and
+ *               height are valid for methods->new.
+ */
+extern T Planar_new(A2Methods_T methods, int width, int height, int size)
+{
+    assert(methods != NULL);
+    assert(size == 1 || size == 2);
+
+    T planar = malloc(sizeof(*planar));
+    assert(planar != NULL);
+    planar->methods = methods;
+    planar->width = width;
+    planar->height = height;
+    planar->size = size;
+    for (int p = 0; p < PLANAR_PLANES; p++) {
+        planar->planes[p] = methods->new(width, height, size);
+    }
+    return planar;
+}
+
+extern void Planar_free(T *planar)
+{
+    assert(planar != NULL && *planar != NULL);
+    for (int p = 0; p < PLANAR_PLANES; p++) {
+        (*planar)->methods->free(&(*planar)->planes[p]);
+    }
+    free(*planar);
+    *planar = NULL;
+}
+
+extern int Planar_width(T planar)
+{
+    assert(planar != NULL);
+    return planar->width;
+}
+
+extern int Planar_height(T planar)
+{
+    assert(planar != NULL);
+    return planar->height;
+}
+
+extern int Planar_size(T planar)
+{
+    assert(planar != NULL);
+    return planar->size;
+}
+
+extern A2Methods_T Planar_methods(T planar)
+{
+    assert(planar != NULL);
+    return planar->methods;
+}
+
+extern A2Methods_UArray2 Planar_plane(T planar, int plane)
+{
+    assert(planar != NULL);
+    assert(plane >= PLANAR_RED && plane < PLANAR_PLANES);
+    return planar->planes[plane];
+}
+
+/*
+ * copy_plane
+ *
+ * Copies src into dst under orient a cell at a time, for suites the
+ * kernels do not know.
+ */
+static void copy_plane(A2Methods_T methods, A2Methods_UArray2 src,
+                       A2Methods_UArray2 dst, Orient_T orient, int size)
+{
+    int width = methods->width(src);
+    int height = methods->height(src);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int col = x;
+            int row = y;
+            Orient_apply(orient, width, height, &col, &row);
+            memcpy(methods->at(dst, col, row), methods->at(src, x, y),
+                   size);
+        }
+    }
+}
+
+/*
+ * Planar_transform
+ *
+ * Each plane on its own: in place if a kernel can and that was asked
+ * for (or costs nothing), otherwise into a new plane that replaces it.
+ */
+extern void Planar_transform(T planar, A2Methods_mapfun *map,
+                             Orient_T orient, int inplace)
+{
+    assert(planar != NULL);
+    assert(orient >= ORIENT_IDENTITY && orient < ORIENT_COUNT);
+    if (orient == ORIENT_IDENTITY) {
+        return;
+    }
+
+    A2Methods_T methods = planar->methods;
+    int width = (orient & ORIENT_TRANSPOSE) ? planar->height
+                                            : planar->width;
+    int height = (orient & ORIENT_TRANSPOSE) ? planar->width
+                                             : planar->height;
+    for (int p = 0; p < PLANAR_PLANES; p++) {
+        A2Methods_UArray2 plane = planar->planes[p];
+        if ((inplace || !(orient & ORIENT_TRANSPOSE)) &&
+            Kernels_transform_inplace(methods, plane, orient)) {
+            continue;
+        }
+        A2Methods_UArray2 oriented = methods->new(width, height,
+                                                  planar->size);
+        if (!Kernels_transform(methods, map, plane, oriented, orient)) {
+            copy_plane(methods, plane, oriented, orient, planar->size);
+        }
+        methods->free(&plane);
+        planar->planes[p] = oriented;
+    }
+    planar->width = width;
+    planar->height = height;
+}
@@ -0,0 +1,81 @@
+/*
+ * planar.h
+ *
+ * Interface for planar images: an image stored as three planes, one
+ * each for the red, green, and blue samples, rather than as an array of
+ * pixels. Each plane is an ordinary A2Methods array (plain, blocked, or
+ * any other suite) whose cells are single samples, one byte each when
+ * the denominator is below 256 and otherwise a 16-bit int.
+ *
+ * A transform is then three independent transforms of single-sample
+ * arrays, whose one- and two-byte cells the kernels (see kernels.h) copy
+ * far more cheaply than 12-byte struct Pnm_rgb. There is no pixel to
+ * point at, so a planar image is not itself an A2Methods array; ppmio.h
+ * reads and writes it, converting to and from interleaved pixels.
+ *
+ * It is a checked run-time error to pass a NULL T to any function in this
+ * interface.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef PLANAR_INCLUDED
+#define PLANAR_INCLUDED
+
+#include "a2methods.h"
+#include "orient.h"
+
+#define T Planar_T
+typedef struct T *T;
+
+/* The planes, in PPM order */
+enum { PLANAR_RED, PLANAR_GREEN, PLANAR_BLUE, PLANAR_PLANES };
+
+/*
+ * Planar_new
+ *
+ * Creates a width x height planar image whose planes are arrays of
+ * methods with cells of size bytes, all zero. size other than 1 or 2 is
+ * a CRE.
+ */
+extern T     Planar_new    (A2Methods_T methods, int width, int height,
+                            int size);
+
+/*
+ * Planar_free
+ *
+ * Frees the image and its planes.
+ */
+extern void  Planar_free   (T *planar);
+
+extern int   Planar_width  (T planar);
+extern int   Planar_height (T planar);
+extern int   Planar_size   (T planar);
+
+extern A2Methods_T       Planar_methods(T planar);
+
+/*
+ * Planar_plane
+ *
+ * Returns the array holding one of the planes, PLANAR_RED .. PLANAR_BLUE
+ * (a CRE otherwise). The array is the image's; the caller may read and
+ * write its cells but not free it.
+ */
+extern A2Methods_UArray2 Planar_plane(T planar, int plane);
+
+/*
+ * Planar_transform
+ *
+ * Applies orient to the image, a plane at a time, with the kernels for
+ * the planes' layout (map picks the walk for plain arrays, as for
+ * Kernels_transform) or, for suites without kernels, through
+ * methods->at. Flips and the 180 degree turn are done in place where a
+ * kernel can; so is everything else if inplace is set. Otherwise each
+ * plane is copied into a new one and the old one freed, so at most one
+ * extra plane is ever allocated.
+ */
+extern void  Planar_transform(T planar, A2Methods_mapfun *map,
+                              Orient_T orient, int inplace);
+
+#undef T
+#endif
@@ -0,0 +1,502 @@
+/*
+ * pool.c
+ *
+ * Implementation file for the thread pool.
+ *
+ * The workers sleep on a condition variable between loops. Pool_run
+ * posts a loop by bumping a generation count, works on it alongside
+ * them, and waits until the last of them is done.
+ *
+ * Within a loop, scheduling is by work stealing. Every thread has a
+ * deque of rectangles of units, and starts with its band of the loop
+ * (see Pool_run_tiles). A thread takes the rectangle at the
+ * bottom of its own deque and, while it is bigger than a leaf, cuts it
+ * in two across its longer side, pushes one half, and carries on with
+ * the other: it works depth first through neighbouring leaves, so what
+ * it reads and writes stays in one region of the images. A thread whose
+ * deque is empty steals from the top of someone else's, where the
+ * biggest rectangle waits, and so takes a whole region for itself.
+ *
+ * The deques are those of Chase and Lev, in the C11 form of Le, Pop,
+ * Cohen, and Zappa Nardelli: the owner pushes and pops at the bottom
+ * with no atomic read-modify-write except when it races a thief for the
+ * last item, and thieves take from the top with one compare-and-swap.
+ * Every rectangle on a deque is half of the one pushed before it, so a
+ * deque never holds more than one per level of cutting, and a fixed
+ * array of DEPTH slots is enough.
+ *
+ * A spread pool has its threads pinned to the NUMA nodes in turn, a
+ * contiguous run of threads per node, and Pool_touch faults memory in
+ * with the same bands, so that the band a thread starts on is on its
+ * node. That loop is posted pinned: each thread runs exactly its own
+ * band, with no deques and so nothing to steal, since a page faulted
+ * by a thief would land on the thief's node.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "assert.h"
+#include "numa.h"
+#include "pool.h"
+
+#define T Pool_T
+
+/* Levels of cutting a rectangle of at most INT_MAX x INT_MAX units */
+#define DEPTH 64
+
+#define PAGE 4096
+
+/* A rectangle of units: columns col0 .. col1 - 1, rows row0 .. row1 - 1 */
+struct rect {
+    int col0, row0, col1, row1;
+};
+
+/* A slot holds a rectangle a thief may read while the owner writes it */
+struct slot {
+    atomic_int col0, row0, col1, row1;
+};
+
+struct deque {
+    atomic_long top;            /* where thieves take */
+    atomic_long bottom;         /* where the owner pushes and pops */
+    struct slot slots[DEPTH];
+} __attribute__((aligned(64)));
+
+struct T {
+    int threads;                /* counting the caller of Pool_run */
+    pthread_t *workers;         /* threads - 1 of them */
+    struct deque *deques;       /* one per thread; the caller's is 0 */
+    pthread_mutex_t lock;
+    pthread_cond_t posted;      /* a loop is posted, or the pool closing */
+    pthread_cond_t finished;    /* the last worker is done with a loop */
+    unsigned long generation;   /* the number of loops posted */
+    int busy;                   /* workers still in the current loop */
+    int closing;
+    int spread;                 /* threads are pinned to NUMA nodes */
+
+    /* the current loop */
+    Pool_tilefun *task;
+    void *cl;
+    int cols, rows;
+    long leaf;
+    int pinned;                 /* each thread runs its own band, whole */
+    atomic_long remaining;      /* units not yet done */
+};
+
+/* What a worker needs to know to start */
+struct start {
+    T pool;
+    int self;
+};
+
+/* Set on pool threads, and on a caller while it works on its loop */
+static __thread int inside;
+
+static T shared;
+
+static void store_rect(struct slot *slot, struct rect r)
+{
+    atomic_store_explicit(&slot->col0, r.col0, memory_order_relaxed);
+    atomic_store_explicit(&slot->row0, r.row0, memory_order_relaxed);
+    atomic_store_explicit(&slot->col1, r.col1, memory_order_relaxed);
+    atomic_store_explicit(&slot->row1, r.row1, memory_order_relaxed);
+}
+
+static struct rect load_rect(struct slot *slot)
+{
+    struct rect r;
+    r.col0 = atomic_load_explicit(&slot->col0, memory_order_relaxed);
+    r.row0 = atomic_load_explicit(&slot->row0, memory_order_relaxed);
+    r.col1 = atomic_load_explicit(&slot->col1, memory_order_relaxed);
+    r.row1 = atomic_load_explicit(&slot->row1, memory_order_relaxed);
+    return r;
+}
+
+/* Pushes r at the bottom of the owner's deque */
+static void push(struct deque *d, struct rect r)
+{
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    assert(b - t < DEPTH);
+    store_rect(&d->slots[b % DEPTH], r);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+/* Pops the bottom of the owner's deque into *r; 0 if it was empty */
+static int pop(struct deque *d, struct rect *r)
+{
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return 0;
+    }
+    *r = load_rect(&d->slots[b % DEPTH]);
+    if (t == b) {
+        /* the last one: a thief may be after it too */
+        int won = atomic_compare_exchange_strong_explicit(
+                          &d->top, &t, t + 1, memory_order_seq_cst,
+                          memory_order_relaxed);
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+    return 1;
+}
+
+/* Takes the top of another thread's deque into *r; 0 if it could not */
+static int steal(struct deque *d, struct rect *r)
+{
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) {
+        return 0;
+    }
+    *r = load_rect(&d->slots[t % DEPTH]);
+    return atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                   memory_order_seq_cst,
+                                                   memory_order_relaxed);
+}
+
+/*
+ * cut
+ *
+ * Works through r depth first: halves go on the deque until what is
+ * left is a leaf, which is run.
+ */
+static void cut(T pool, struct deque *d, struct rect r)
+{
+    for (;;) {
+        long cols = r.col1 - r.col0;
+        long rows = r.row1 - r.row0;
+        if (cols * rows <= pool->leaf) {
+            pool->task(r.col0, r.row0, r.col1, r.row1, pool->cl);
+            atomic_fetch_sub(&pool->remaining, cols * rows);
+            return;
+        }
+        struct rect half = r;
+        if (cols >= rows) {
+            half.col0 = r.col1 = r.col0 + cols / 2;
+        } else {
+            half.row0 = r.row1 = r.row0 + rows / 2;
+        }
+        push(d, half);
+    }
+}
+
+/*
+ * band
+ *
+ * Band i of the bands a cols x rows loop is cut into, one per thread:
+ * rows if there are enough of them, otherwise columns, and otherwise
+ * the whole loop for thread 0 alone.
+ */
+static struct rect band(int cols, int rows, int i, int bands)
+{
+    struct rect r = { 0, 0, cols, rows };
+    if (rows >= bands) {
+        r.row0 = (long)rows * i / bands;
+        r.row1 = (long)rows * (i + 1) / bands;
+    } else if (cols >= bands) {
+        r.col0 = (long)cols * i / bands;
+        r.col1 = (long)cols * (i + 1) / bands;
+    } else if (i > 0) {
+        r.col1 = r.col0;
+    }
+    return r;
+}
+
+/*
+ * work
+ *
+ * Runs thread self's share of the current loop: its own deque first,
+ * then whatever it can steal, until no units are left anywhere.
+ */
+static void work(T pool, int self)
+{
+    struct deque *own = &pool->deques[self];
+    unsigned seed = 2654435761u * (self + 1);
+    struct rect r;
+
+    while (atomic_load(&pool->remaining) > 0) {
+        if (pop(own, &r)) {
+            cut(pool, own, r);
+            continue;
+        }
+        int stolen = 0;
+        for (int tries = 0; tries < pool->threads && !stolen; tries++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            int victim = seed % pool->threads;
+            stolen = victim != self && steal(&pool->deques[victim], &r);
+        }
+        if (stolen) {
+            cut(pool, own, r);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+/*
+ * run_band
+ *
+ * Runs thread self's share of the current, pinned, loop: its band,
+ * whole.
+ */
+static void run_band(T pool, int self)
+{
+    struct rect r = band(pool->cols, pool->rows, self, pool->threads);
+    if (r.col0 < r.col1 && r.row0 < r.row1) {
+        pool->task(r.col0, r.row0, r.col1, r.row1, pool->cl);
+    }
+}
+
+static void *worker(void *vstart)
+{
+    struct start *start = vstart;
+    T pool = start->pool;
+    int self = start->self;
+    unsigned long seen = 0;
+    free(start);
+    inside = 1;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->closing) {
+            pthread_cond_wait(&pool->posted, &pool->lock);
+        }
+        if (pool->closing) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        if (pool->pinned) {
+            run_band(pool, self);
+        } else {
+            work(pool, self);
+        }
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->finished);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+extern T Pool_new(int threads)
+{
+    assert(threads >= 1);
+    T pool = calloc(1, sizeof(*pool));
+    assert(pool != NULL);
+    pool->threads = threads;
+    pool->workers = malloc((threads - 1) * sizeof(pool->workers[0]) + 1);
+    assert(pool->workers != NULL);
+    pool->deques = aligned_alloc(64, threads * sizeof(pool->deques[0]));
+    assert(pool->deques != NULL);
+    for (int i = 0; i < threads; i++) {
+        atomic_init(&pool->deques[i].top, 0);
+        atomic_init(&pool->deques[i].bottom, 0);
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->posted, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    atomic_init(&pool->remaining, 0);
+
+    for (int i = 0; i < threads - 1; i++) {
+        struct start *start = malloc(sizeof(*start));
+        assert(start != NULL);
+        start->pool = pool;
+        start->self = i + 1;
+        int failed = pthread_create(&pool->workers[i], NULL, worker, start);
+        assert(!failed);
+    }
+    return pool;
+}
+
+extern void Pool_free(T *pool)
+{
+    assert(pool != NULL && *pool != NULL);
+    T p = *pool;
+
+    pthread_mutex_lock(&p->lock);
+    p->closing = 1;
+    pthread_cond_broadcast(&p->posted);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->threads - 1; i++) {
+        pthread_join(p->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&p->finished);
+    pthread_cond_destroy(&p->posted);
+    pthread_mutex_destroy(&p->lock);
+    if (shared == p) {
+        shared = NULL;
+    }
+    free(p->deques);
+    free(p->workers);
+    free(p);
+    *pool = NULL;
+}
+
+extern int Pool_threads(T pool)
+{
+    assert(pool != NULL);
+    return pool->threads;
+}
+
+extern void Pool_spread(T pool)
+{
+    assert(pool != NULL);
+    int nodes = Numa_nodes();
+    Numa_bind(pthread_self(), 0);
+    for (int i = 1; i < pool->threads; i++) {
+        Numa_bind(pool->workers[i - 1], (long)i * nodes / pool->threads);
+    }
+    pool->spread = 1;
+}
+
+extern int Pool_spread_node(T pool, int thread)
+{
+    assert(pool != NULL);
+    assert(thread >= 0 && thread < pool->threads);
+    return pool->spread ? (long)thread * Numa_nodes() / pool->threads : -1;
+}
+
+/*
+ * post
+ *
+ * Runs a cols x rows loop, which is more than one leaf, on every thread
+ * of pool, the caller's included, and waits for it to finish. A pinned
+ * loop is not cut up: each thread runs its band of it.
+ */
+static void post(T pool, int cols, int rows, long leaf, Pool_tilefun *task,
+                 void *cl, int pinned)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->cl = cl;
+    pool->cols = cols;
+    pool->rows = rows;
+    pool->leaf = leaf;
+    pool->pinned = pinned;
+    atomic_store(&pool->remaining, (long)cols * rows);
+    for (int i = 0; i < pool->threads && !pinned; i++) {
+        struct rect r = band(cols, rows, i, pool->threads);
+        if (r.col0 < r.col1 && r.row0 < r.row1) {
+            push(&pool->deques[i], r);
+        }
+    }
+    pool->busy = pool->threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->posted);
+    pthread_mutex_unlock(&pool->lock);
+
+    inside = 1;
+    if (pinned) {
+        run_band(pool, 0);
+    } else {
+        work(pool, 0);
+    }
+    inside = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Pool_touch writes a zero to every page of a band */
+struct touch {
+    char *base;
+    size_t bytes;
+    size_t pages;
+};
+
+static void touch_band(int col0, int row0, int col1, int row1, void *vcl)
+{
+    struct touch *cl = vcl;
+    (void)row0;
+    (void)row1;
+    for (size_t page = col0; page < (size_t)col1; page++) {
+        cl->base[page * PAGE] = 0;
+    }
+    if ((size_t)col1 == cl->pages) {
+        cl->base[cl->bytes - 1] = 0;
+    }
+}
+
+extern void Pool_touch(T pool, void *addr, size_t bytes)
+{
+    if (pool == NULL || !pool->spread || bytes == 0) {
+        return;
+    }
+    assert(addr != NULL);
+    struct touch cl = { addr, bytes, (bytes + PAGE - 1) / PAGE };
+    assert(cl.pages <= INT_MAX);
+    if (pool->threads == 1 || inside) {
+        touch_band(0, 0, cl.pages, 1, &cl);
+        return;
+    }
+    post(pool, cl.pages, 1, 1, touch_band, &cl, 1);
+}
+
+extern void Pool_run_tiles(T pool, int cols, int rows, long leaf,
+                           Pool_tilefun *task, void *cl)
+{
+    assert(cols >= 0 && rows >= 0 && leaf > 0);
+    assert(task != NULL);
+    long units = (long)cols * rows;
+    if (pool == NULL || pool->threads == 1 || inside || units <= leaf) {
+        if (units > 0) {
+            task(0, 0, cols, rows, cl);
+        }
+        return;
+    }
+    post(pool, cols, rows, leaf, task, cl, 0);
+}
+
+/* Pool_run is a loop over a single row of units */
+struct range_closure {
+    Pool_rangefun *task;
+    void *cl;
+};
+
+static void run_range(int col0, int row0, int col1, int row1, void *vcl)
+{
+    struct range_closure *cl = vcl;
+    (void)row0;
+    (void)row1;
+    cl->task(col0, col1, cl->cl);
+}
+
+extern void Pool_run(T pool, int count, int grain, Pool_rangefun *task,
+                     void *cl)
+{
+    assert(count >= 0 && grain > 0);
+    assert(task != NULL);
+    struct range_closure mycl = { task, cl };
+    Pool_run_tiles(pool, count, 1, grain, run_range, &mycl);
+}
+
+extern void Pool_set_default(T pool)
+{
+    shared = pool;
+}
+
+extern T Pool_default(void)
+{
+    return shared;
+}
@@ -0,0 +1,133 @@
+/*
+ * pool.h
+ *
+ * Interface for a pool of worker threads, created once and reused for
+ * every parallel loop in the program. A loop is a rectangle of
+ * independent units of work (tiles of cells, blocks), or a row of them,
+ * shared out among the workers and the calling thread by work stealing:
+ * it is cut in halves recursively, each thread works through
+ * neighbouring pieces depth first, and a thread that runs out takes the
+ * biggest piece still waiting on another's deque. So an uneven split
+ * (clipped edge blocks, a very wide or very tall image) evens out on its
+ * own, and each thread's reads and writes stay within one region of
+ * memory.
+ *
+ * The parallel maps of the A2Methods suites (see a2methods.h) and the
+ * transform kernels (see kernels.h) run on the default pool, which is
+ * NULL, and everything sequential, until a client sets one.
+ *
+ * It is a checked run-time error to pass a NULL T to any function in this
+ * interface, except where noted.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef POOL_INCLUDED
+#define POOL_INCLUDED
+
+#include <stddef.h>
+
+#define T Pool_T
+typedef struct T *T;
+
+/*
+ * Pool_rangefun, Pool_tilefun
+ *
+ * Do units first .. last - 1 of a loop, or the units in columns col0 ..
+ * col1 - 1 of rows row0 .. row1 - 1, with cl as given to Pool_run or
+ * Pool_run_tiles.
+ */
+typedef void Pool_rangefun(int first, int last, void *cl);
+typedef void Pool_tilefun(int col0, int row0, int col1, int row1,
+                          void *cl);
+
+/*
+ * Pool_new
+ *
+ * Creates a pool of threads threads, counting the one that calls
+ * Pool_run: threads - 1 workers are started, and wait for work. threads
+ * less than 1 is a CRE.
+ */
+extern T    Pool_new    (int threads);
+
+/*
+ * Pool_free
+ *
+ * Stops the workers and frees the pool, which must be idle. If it is the
+ * default pool, there is no longer one.
+ */
+extern void Pool_free   (T *pool);
+
+extern int  Pool_threads(T pool);
+
+/*
+ * Pool_run_tiles
+ *
+ * Calls task on rectangles that together cover the cols x rows units
+ * exactly once, spread over the pool's threads, and returns when all of
+ * them are done. Rectangles are halved across their longer side until
+ * they hold at most leaf units. When pool is NULL (allowed here), has
+ * one thread, or is asked to run a loop from inside one of its own
+ * tasks, the whole loop is a single call on the calling thread.
+ *
+ * Expectations: cols and rows are >= 0 and leaf > 0 (CREs); task is safe
+ *               to run on several threads at once, and the rectangles it
+ *               is handed touch disjoint memory. One loop runs on a pool
+ *               at a time.
+ */
+extern void Pool_run_tiles(T pool, int cols, int rows, long leaf,
+                           Pool_tilefun *task, void *cl);
+
+/*
+ * Pool_run
+ *
+ * Pool_run_tiles on a single row of count units, handed to task as
+ * ranges of at most grain units (or the whole row, as above).
+ */
+extern void Pool_run    (T pool, int count, int grain, Pool_rangefun *task,
+                         void *cl);
+
+/*
+ * Pool_spread
+ *
+ * Pins the pool's threads to the machine's NUMA nodes (see numa.h), a
+ * contiguous run of them per node, with the calling thread, as thread
+ * 0, on the first. From then on, thread i starts every loop on band i of
+ * it (rows of units if there are enough, otherwise columns), and
+ * Pool_touch places memory to match, so a thread mostly works on memory
+ * of its own node; work stealing still moves pieces between threads
+ * when they fall behind.
+ */
+extern void Pool_spread(T pool);
+
+/*
+ * Pool_spread_node
+ *
+ * The node thread (0 .. Pool_threads(pool) - 1) is pinned to, or -1 if
+ * the pool is not spread.
+ */
+extern int  Pool_spread_node(T pool, int thread);
+
+/*
+ * Pool_touch
+ *
+ * Faults in the pages of the bytes at addr, which must not have been
+ * touched yet, each from the thread whose band of a loop over them it
+ * falls in, so that the kernel places them on that thread's node. The
+ * bands are not shared out by work stealing: each thread touches its
+ * own band and nothing else. Does nothing if pool is NULL (allowed
+ * here) or not spread.
+ */
+extern void Pool_touch(T pool, void *addr, size_t bytes);
+
+/*
+ * Pool_set_default, Pool_default
+ *
+ * Set and get the pool the parallel maps and kernels use. NULL (allowed
+ * here) makes them run on the calling thread alone.
+ */
+extern void Pool_set_default(T pool);
+extern T    Pool_default    (void);
+
+#undef T
+#endif
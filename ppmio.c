@@ -0,0 +1,1061 @@
+/*
+ * ppmio.c
+ *
+ * Implementation of our PPM input and output.
+ *
+ * Pixels are held packed, as they are in a binary raster. Binary images
+ * in regular files are mapped rather than read; unoriented, they go
+ * straight from the mapping into the array, a span (see
+ * A2Methods_rowfun) at a time.
+ *
+ * Otherwise images are read BAND rows at a time. Each band, straight
+ * from the mapping or read (and for plain images decoded and packed)
+ * into a buffer, is handed to Kernels_scatter, which puts it where the
+ * orientation sends it, or placed through methods->at for suites
+ * without kernels.
+ *
+ * Binary images in regular files can also be streamed: flips and the
+ * 180 degree turn move rows whole, so the rows are read, BAND at a
+ * time, from wherever the orientation needs them and written straight
+ * out, and the image is never in memory.
+ *
+ * Images too big for memory are transformed out of core, through a
+ * UArray2d holding the oriented image on disk in blocks. The input is
+ * read in bands of source rows chosen so that each band fills exactly
+ * one stripe of destination blocks (a block column when transposing, a
+ * block row otherwise); each of those blocks is filled once and spilled.
+ * The output is then assembled a block row at a time. Memory is one
+ * band plus the block cache, both sized from the caller's limit.
+ *
+ * The image is written BAND rows (or whole block rows) at a time. A
+ * band is first gathered into a plain buffer of pixels - by the kernels
+ * where they know the layout (see Kernels_gather), through methods->at
+ * otherwise - and then narrowed into large batches that go out with
+ * writev (see struct sink). For a view the gather reads the
+ * array underneath directly, so a rotated image goes from the original
+ * pixels to the output in one pass, and only a band of it is ever held
+ * in memory. BAND matches the transpose engine's tile side.
+ *
+ * Planar images go through the same bands, split into planes with byte
+ * shuffles after decoding and merged back before encoding (see
+ * samples.h); each plane is scattered or gathered on its own.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#define _GNU_SOURCE             /* for copy_file_range */
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "except.h"
+#include "ppmio.h"
+#include "a2view.h"
+#include "kernels.h"
+#include "uarray2d.h"
+#include "samples.h"
+#include "slab.h"
+
+#define BAND 64
+#define BATCH (1 << 20)         /* bytes the writer hands over at once */
+
+/*
+ * read_number
+ *
+ * Reads an unsigned decimal number from a PPM header, skipping the
+ * whitespace and comments before it.
+ */
+static unsigned read_number(FILE *fp)
+{
+    int c = getc(fp);
+    while (isspace(c) || c == '#') {
+        if (c == '#') {
+            while (c != '\n' && c != EOF) {
+                c = getc(fp);
+            }
+        }
+        c = getc(fp);
+    }
+    if (!isdigit(c)) {
+        RAISE(Pnm_Badformat);
+    }
+    unsigned long n = 0;
+    while (isdigit(c)) {
+        n = n * 10 + (c - '0');
+        if (n > 0xffffffffUL) {
+            RAISE(Pnm_Badformat);
+        }
+        c = getc(fp);
+    }
+    ungetc(c, fp);
+    return n;
+}
+
+/* What a PPM header says */
+struct header {
+    int raw;                    /* P6, as opposed to plain P3 */
+    unsigned width, height, denominator;
+};
+
+/*
+ * read_header
+ *
+ * Reads a PPM header from fp, leaving fp at the first byte of the
+ * raster. Raises Pnm_Badformat if it is not one.
+ */
+static void read_header(FILE *fp, struct header *header)
+{
+    if (getc(fp) != 'P') {
+        RAISE(Pnm_Badformat);
+    }
+    int magic = getc(fp);
+    if (magic != '3' && magic != '6') {
+        RAISE(Pnm_Badformat);
+    }
+    header->raw = magic == '6';
+    header->width = read_number(fp);
+    header->height = read_number(fp);
+    header->denominator = read_number(fp);
+    if (header->width == 0 || header->height == 0 ||
+        header->width > INT_MAX || header->height > INT_MAX ||
+        header->denominator == 0 || header->denominator > 65535 ||
+        !isspace(getc(fp))) {
+        RAISE(Pnm_Badformat);
+    }
+}
+
+/*
+ * encode_band
+ *
+ * Packs pixels into bytes, as Pnm_ppmwrite does: one byte per sample if
+ * the denominator is below 256, otherwise two, most significant first.
+ * Returns the number of bytes.
+ */
+static size_t encode_band(const struct Pnm_rgb *pixels, size_t count,
+                          unsigned denominator, unsigned char *bytes)
+{
+    if (denominator < 256) {
+        Samples_narrow8(&pixels->red, bytes, 3 * count);
+        return 3 * count;
+    }
+    Samples_narrow16(&pixels->red, bytes, 3 * count);
+    return 6 * count;
+}
+
+/*
+ * decode_band
+ *
+ * Reads count pixels of a plain raster into pixels, a number at a time.
+ */
+static void decode_band(FILE *fp, struct Pnm_rgb *pixels, size_t count)
+{
+    for (size_t k = 0; k < count; k++) {
+        pixels[k].red = read_number(fp);
+        pixels[k].green = read_number(fp);
+        pixels[k].blue = read_number(fp);
+    }
+}
+
+/* A file mapped into memory */
+struct mapping {
+    void *base;
+    size_t length;
+};
+
+/*
+ * map_raster
+ *
+ * Maps the binary raster that fp, a regular file, is positioned at,
+ * prefaulted and marked for sequential reading, and moves fp past it.
+ * Returns its first byte, or NULL if fp cannot be mapped. Raises
+ * Pnm_Badformat if the file is too short for the header's dimensions.
+ */
+static const unsigned char *map_raster(FILE *fp, const struct header *header,
+                                       struct mapping *mapping)
+{
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return NULL;
+    }
+    off_t offset = ftello(fp);
+    size_t cellbytes = header->denominator < 256 ? 3 : 6;
+    size_t rowbytes = (size_t)header->width * cellbytes;
+    if (offset < 0 ||
+        (uintmax_t)(st.st_size - offset) / rowbytes < header->height) {
+        RAISE(Pnm_Badformat);
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    mapping->length = offset + rowbytes * header->height;
+    mapping->base = mmap(NULL, mapping->length, PROT_READ, flags,
+                         fileno(fp), 0);
+    if (mapping->base == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(mapping->base, mapping->length, MADV_SEQUENTIAL);
+    fseeko(fp, (off_t)mapping->length, SEEK_SET);
+    return (const unsigned char *)mapping->base + offset;
+}
+
+/* Where map_rows finds the raster for each span */
+struct raster {
+    const unsigned char *bytes;
+    size_t rowbytes;
+    size_t cellbytes;
+};
+
+static void fill_span(int i, int j, int n, A2Methods_UArray2 array,
+                      void *span, void *cl)
+{
+    struct raster *raster = cl;
+    const unsigned char *bytes = raster->bytes + j * raster->rowbytes +
+                                 i * raster->cellbytes;
+    (void)array;
+    memcpy(span, bytes, n * raster->cellbytes);
+}
+
+/*
+ * scatter_band
+ *
+ * Puts rows row .. row + height - 1 of the source image, held in cells
+ * of size bytes, where orient sends them in array.
+ */
+static void scatter_band(A2Methods_T methods, A2Methods_UArray2 array,
+                         Orient_T orient, int srcwidth, int srcheight,
+                         int row, int height, const void *cells,
+                         size_t size)
+{
+    if (Kernels_scatter(methods, array, orient, 0, row, srcwidth, height,
+                        cells)) {
+        return;
+    }
+
+    const char *cell = cells;
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < srcwidth; i++) {
+            int col = i;
+            int r = row + j;
+            Orient_apply(orient, srcwidth, srcheight, &col, &r);
+            memcpy(methods->at(array, col, r), cell, size);
+            cell += size;
+        }
+    }
+}
+
+extern size_t Ppmio_packed_size(unsigned denominator)
+{
+    return denominator < 256 ? 3 : 6;
+}
+
+/*
+ * packed_band
+ *
+ * The count pixels of the raster from row onward, packed: straight from
+ * the mapping if raster is one, otherwise read into bytes (plain ones
+ * decoded into pixels on the way).
+ */
+static const unsigned char *packed_band(FILE *fp,
+                                        const struct header *header,
+                                        const unsigned char *raster,
+                                        unsigned row, size_t count,
+                                        unsigned char *bytes,
+                                        struct Pnm_rgb *pixels)
+{
+    size_t cellbytes = Ppmio_packed_size(header->denominator);
+    if (raster != NULL) {
+        return raster + (size_t)row * header->width * cellbytes;
+    } else if (header->raw) {
+        if (fread(bytes, 1, count * cellbytes, fp) != count * cellbytes) {
+            RAISE(Pnm_Badformat);
+        }
+    } else {
+        decode_band(fp, pixels, count);
+        encode_band(pixels, count, header->denominator, bytes);
+    }
+    return bytes;
+}
+
+/*
+ * Ppmio_read_packed
+ *
+ * The header, then the raster a band at a time. Bands from a mapping are
+ * scattered straight from it; bands from stdio are read into a buffer
+ * (plain ones decoded and packed on the way).
+ */
+extern Pnm_ppm Ppmio_read_packed(FILE *fp, A2Methods_T methods,
+                                 Orient_T orient)
+{
+    assert(fp != NULL);
+    assert(methods != NULL);
+    assert(orient >= ORIENT_IDENTITY && orient < ORIENT_COUNT);
+
+    struct header header;
+    read_header(fp, &header);
+    unsigned width = header.width;
+    unsigned height = header.height;
+    unsigned denominator = header.denominator;
+
+    Pnm_ppm ppm = malloc(sizeof(*ppm));
+    assert(ppm != NULL);
+    ppm->denominator = denominator;
+    ppm->width = (orient & ORIENT_TRANSPOSE) ? height : width;
+    ppm->height = (orient & ORIENT_TRANSPOSE) ? width : height;
+    size_t cellbytes = Ppmio_packed_size(denominator);
+    ppm->pixels = methods->new(ppm->width, ppm->height, cellbytes);
+    ppm->methods = methods;
+
+    struct mapping mapping;
+    const unsigned char *raster = header.raw ? map_raster(fp, &header,
+                                                          &mapping)
+                                             : NULL;
+
+    /* unoriented, from the mapping: straight into place */
+    if (raster != NULL && orient == ORIENT_IDENTITY &&
+        methods->map_rows != NULL) {
+        struct raster cl = { raster, width * cellbytes, cellbytes };
+        methods->map_rows(ppm->pixels, fill_span, &cl);
+        munmap(mapping.base, mapping.length);
+        return ppm;
+    }
+
+    size_t bandcells = (size_t)width * BAND;
+    struct Pnm_rgb *pixels = NULL;
+    if (!header.raw) {
+        pixels = malloc(bandcells * sizeof(*pixels));
+        assert(pixels != NULL);
+    }
+    unsigned char *bytes = NULL;
+    if (raster == NULL) {
+        bytes = malloc(bandcells * cellbytes);
+        assert(bytes != NULL);
+    }
+
+    for (unsigned row = 0; row < height; row += BAND) {
+        int rows = height - row < BAND ? height - row : BAND;
+        size_t count = (size_t)width * rows;
+        const void *cells = packed_band(fp, &header, raster, row, count,
+                                        bytes, pixels);
+        scatter_band(methods, ppm->pixels, orient, width, height, row, rows,
+                     cells, cellbytes);
+    }
+    free(bytes);
+    free(pixels);
+    if (raster != NULL) {
+        munmap(mapping.base, mapping.length);
+    }
+    return ppm;
+}
+
+/*
+ * Ppmio_read_planar
+ *
+ * As Ppmio_read_packed, but each band is split into planes
+ * and each plane scattered on its own: splitting and orienting are one
+ * pass over the image.
+ */
+extern Planar_T Ppmio_read_planar(FILE *fp, A2Methods_T methods,
+                                  Orient_T orient, unsigned *denominator)
+{
+    assert(fp != NULL);
+    assert(methods != NULL);
+    assert(denominator != NULL);
+    assert(orient >= ORIENT_IDENTITY && orient < ORIENT_COUNT);
+
+    struct header header;
+    read_header(fp, &header);
+    int width = header.width;
+    int height = header.height;
+    int transposed = orient & ORIENT_TRANSPOSE;
+    size_t samplebytes = header.denominator < 256 ? 1 : 2;
+    Planar_T planar = Planar_new(methods, transposed ? height : width,
+                                 transposed ? width : height, samplebytes);
+
+    struct mapping mapping;
+    const unsigned char *raster = header.raw ? map_raster(fp, &header,
+                                                          &mapping)
+                                             : NULL;
+    size_t bandcells = (size_t)width * BAND;
+    struct Pnm_rgb *pixels = NULL;
+    if (!header.raw) {
+        pixels = malloc(bandcells * sizeof(*pixels));
+        assert(pixels != NULL);
+    }
+    unsigned char *bytes = NULL;
+    if (raster == NULL) {
+        bytes = malloc(bandcells * 3 * samplebytes);
+        assert(bytes != NULL);
+    }
+    unsigned char *planes = malloc(bandcells * 3 * samplebytes);
+    assert(planes != NULL);
+
+    for (int row = 0; row < height; row += BAND) {
+        int rows = height - row < BAND ? height - row : BAND;
+        size_t count = (size_t)width * rows;
+        const unsigned char *band = packed_band(fp, &header, raster, row,
+                                                count, bytes, pixels);
+        unsigned char *plane[PLANAR_PLANES] = {
+            planes, planes + count * samplebytes,
+            planes + 2 * count * samplebytes
+        };
+        if (samplebytes == 1) {
+            Samples_split8(band, plane[0], plane[1], plane[2], count);
+        } else {
+            Samples_split16(band, (uint16_t *)plane[0],
+                            (uint16_t *)plane[1], (uint16_t *)plane[2],
+                            count);
+        }
+        for (int p = 0; p < PLANAR_PLANES; p++) {
+            scatter_band(methods, Planar_plane(planar, p), orient, width,
+                         height, row, rows, plane[p], samplebytes);
+        }
+    }
+    free(planes);
+    free(bytes);
+    free(pixels);
+    if (raster != NULL) {
+        munmap(mapping.base, mapping.length);
+    }
+    *denominator = header.denominator;
+    return planar;
+}
+
+/*
+ * gather_band
+ *
+ * Fills pixels, cells of size bytes, with rows row .. row + height - 1
+ * of array.
+ */
+static void gather_band(A2Methods_T methods, A2Methods_UArray2 array,
+                        int row, int height, void *pixels, size_t size)
+{
+    int width = methods->width(array);
+
+    /* a view is read straight from the array underneath */
+    if (methods == uarray2_methods_view) {
+        struct A2View_source source;
+        A2View_get_source(array, &source);
+        if (Kernels_gather(source.methods, source.array, source.orient,
+                           source.col, source.row + row, width, height,
+                           pixels)) {
+            return;
+        }
+    } else if (Kernels_gather(methods, array, ORIENT_IDENTITY, 0, row,
+                              width, height, pixels)) {
+        return;
+    }
+
+    char *cell = pixels;
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            memcpy(cell, methods->at(array, i, row + j), size);
+            cell += size;
+        }
+    }
+}
+
+/*
+ * band_height
+ *
+ * How many rows of array to gather at a time: BAND, rounded up to whole
+ * block rows for a blocked array.
+ */
+static int band_height(A2Methods_T methods, A2Methods_UArray2 array)
+{
+    int blocksize = methods->blocksize(array);
+    if (blocksize > 1) {
+        return (BAND + blocksize - 1) / blocksize * blocksize;
+    }
+    return BAND;
+}
+
+/*
+ * A sink collects the encoded raster in a page-aligned batch and hands
+ * it to the kernel in one call, writev, with the header in front of the
+ * first batch.
+ */
+struct sink {
+    FILE *fp;
+    int fd;                     /* -1 to go through fp */
+    char header[64];
+    size_t headerlen;           /* header bytes not yet written */
+    unsigned char *batch;
+    size_t size;
+    size_t used;
+};
+
+/*
+ * write_all
+ *
+ * Writes the n buffers of iov to fd, however many calls it takes,
+ * starting again if a signal interrupts one. Any other failure is
+ * reported and ends the program, as there is no writing the image.
+ */
+static void write_all(int fd, struct iovec *iov, int n)
+{
+    while (n > 0) {
+        ssize_t done = writev(fd, iov, n);
+        if (done < 0 && errno == EINTR) {
+            continue;
+        } else if (done < 0) {
+            perror("writing the image");
+            exit(EXIT_FAILURE);
+        }
+        while (n > 0 && (size_t)done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (char *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+}
+
+static void sink_flush(struct sink *sink)
+{
+    if (sink->fd < 0) {
+        size_t n = fwrite(sink->header, 1, sink->headerlen, sink->fp);
+        n += fwrite(sink->batch, 1, sink->used, sink->fp);
+        assert(n == sink->headerlen + sink->used);
+    } else {
+        struct iovec iov[2] = { { sink->header, sink->headerlen },
+                                { sink->batch, sink->used } };
+        write_all(sink->fd, iov, 2);
+    }
+    sink->headerlen = 0;
+    sink->used = 0;
+}
+
+static void sink_open(struct sink *sink, FILE *fp, unsigned width,
+                      unsigned height, unsigned denominator)
+{
+    sink->fp = fp;
+    sink->headerlen = snprintf(sink->header, sizeof(sink->header),
+                               "P6\n%u %u\n%u\n", width, height,
+                               denominator);
+    fflush(fp);
+    sink->fd = fileno(fp);
+    sink->size = BATCH;
+    sink->batch = Slab_alloc(sink->size, SLAB_PAGE);
+    sink->used = 0;
+}
+
+/*
+ * sink_samples
+ *
+ * Encodes count samples into the batch, flushing it whenever it fills.
+ */
+static void sink_samples(struct sink *sink, const unsigned *samples,
+                         size_t count, unsigned denominator)
+{
+    size_t samplebytes = denominator < 256 ? 1 : 2;
+    while (count > 0) {
+        size_t room = (sink->size - sink->used) / samplebytes;
+        size_t n = count < room ? count : room;
+        unsigned char *p = sink->batch + sink->used;
+        if (samplebytes == 1) {
+            Samples_narrow8(samples, p, n);
+        } else {
+            Samples_narrow16(samples, p, n);
+        }
+        sink->used += n * samplebytes;
+        samples += n;
+        count -= n;
+        if (sink->size - sink->used < samplebytes) {
+            sink_flush(sink);
+        }
+    }
+}
+
+/*
+ * sink_bytes
+ *
+ * Copies n bytes of already encoded raster into the batch, flushing it
+ * whenever it fills.
+ */
+static void sink_bytes(struct sink *sink, const unsigned char *bytes,
+                       size_t n)
+{
+    while (n > 0) {
+        size_t room = sink->size - sink->used;
+        size_t k = n < room ? n : room;
+        memcpy(sink->batch + sink->used, bytes, k);
+        sink->used += k;
+        bytes += k;
+        n -= k;
+        if (sink->used == sink->size) {
+            sink_flush(sink);
+        }
+    }
+}
+
+static void sink_close(struct sink *sink)
+{
+    if (sink->used > 0 || sink->headerlen > 0) {
+        sink_flush(sink);
+    }
+    Slab_free(sink->batch);
+}
+
+/*
+ * Ppmio_write
+ *
+ * The pixels a band at a time into the sink. For a blocked array a band
+ * is whole block rows, so each block is read once, start to finish.
+ */
+extern void Ppmio_write(FILE *fp, Pnm_ppm ppm)
+{
+    assert(fp != NULL);
+    assert(ppm != NULL && ppm->methods != NULL && ppm->pixels != NULL);
+    size_t size = ppm->methods->size(ppm->pixels);
+    int packed = size == Ppmio_packed_size(ppm->denominator);
+    assert(packed || size == sizeof(struct Pnm_rgb));
+    assert((unsigned)ppm->methods->width(ppm->pixels) == ppm->width);
+    assert((unsigned)ppm->methods->height(ppm->pixels) == ppm->height);
+
+    A2Methods_T methods = (A2Methods_T)ppm->methods;
+    int band = band_height(methods, ppm->pixels);
+    unsigned char *pixels = malloc((size_t)ppm->width * band * size + 1);
+    assert(pixels != NULL);
+
+    struct sink sink;
+    sink_open(&sink, fp, ppm->width, ppm->height, ppm->denominator);
+    for (unsigned row = 0; row < ppm->height; row += band) {
+        int height = ppm->height - row < (unsigned)band ? ppm->height - row
+                                                        : (unsigned)band;
+        size_t count = (size_t)ppm->width * height;
+        gather_band(methods, ppm->pixels, row, height, pixels, size);
+        if (packed) {
+            sink_bytes(&sink, pixels, count * size);
+        } else {
+            sink_samples(&sink, (const unsigned *)pixels, 3 * count,
+                         ppm->denominator);
+        }
+    }
+    sink_close(&sink);
+    free(pixels);
+}
+
+/*
+ * Ppmio_write_planar
+ *
+ * A band of each plane, merged into packed pixels, into the sink.
+ */
+extern void Ppmio_write_planar(FILE *fp, Planar_T planar,
+                               unsigned denominator)
+{
+    assert(fp != NULL);
+    assert(planar != NULL);
+    size_t samplebytes = Planar_size(planar);
+    assert(samplebytes == (denominator < 256 ? 1u : 2u));
+
+    A2Methods_T methods = Planar_methods(planar);
+    int width = Planar_width(planar);
+    int height = Planar_height(planar);
+    int band = band_height(methods, Planar_plane(planar, PLANAR_RED));
+    size_t bandcells = (size_t)width * band;
+    unsigned char *planes = malloc(bandcells * 3 * samplebytes);
+    unsigned char *bytes = malloc(bandcells * 3 * samplebytes);
+    assert(planes != NULL && bytes != NULL);
+
+    struct sink sink;
+    sink_open(&sink, fp, width, height, denominator);
+    for (int row = 0; row < height; row += band) {
+        int rows = height - row < band ? height - row : band;
+        size_t count = (size_t)width * rows;
+        unsigned char *plane[PLANAR_PLANES];
+        for (int p = 0; p < PLANAR_PLANES; p++) {
+            plane[p] = planes + p * count * samplebytes;
+            gather_band(methods, Planar_plane(planar, p), row, rows,
+                        plane[p], samplebytes);
+        }
+        if (samplebytes == 1) {
+            Samples_merge8(plane[0], plane[1], plane[2], bytes, count);
+        } else {
+            Samples_merge16((uint16_t *)plane[0], (uint16_t *)plane[1],
+                            (uint16_t *)plane[2], bytes, count);
+        }
+        sink_bytes(&sink, bytes, count * 3 * samplebytes);
+    }
+    sink_close(&sink);
+    free(bytes);
+    free(planes);
+}
+
+/*
+ * read_at
+ *
+ * Reads exactly n bytes at offset of fd. Raises Pnm_Badformat if the
+ * file ends first.
+ */
+static void read_at(int fd, unsigned char *buf, size_t n, off_t offset)
+{
+    while (n > 0) {
+        ssize_t got = pread(fd, buf, n, offset);
+        if (got <= 0) {
+            RAISE(Pnm_Badformat);
+        }
+        buf += got;
+        n -= got;
+        offset += got;
+    }
+}
+
+/*
+ * reverse_cells
+ *
+ * Reverses the order of the count cells of cellbytes bytes in row.
+ */
+static void reverse_cells(unsigned char *row, size_t count, size_t cellbytes)
+{
+    unsigned char tmp[6];
+    unsigned char *a = row;
+    unsigned char *b = row + (count - 1) * cellbytes;
+    while (a < b) {
+        memcpy(tmp, a, cellbytes);
+        memcpy(a, b, cellbytes);
+        memcpy(b, tmp, cellbytes);
+        a += cellbytes;
+        b -= cellbytes;
+    }
+}
+
+/*
+ * Ppmio_stream
+ *
+ * Checks that in is a regular file holding a binary PPM, then writes it
+ * out a band of rows at a time: output rows v0 .. v0 + rows - 1 come
+ * from one contiguous run of source rows, read with a single pread and
+ * emitted bottom up for a vertical flip, each reversed for a horizontal
+ * one.
+ */
+extern int Ppmio_stream(FILE *in, FILE *out, Orient_T orient,
+                        unsigned *width, unsigned *height)
+{
+    assert(in != NULL && out != NULL);
+    assert(width != NULL && height != NULL);
+    assert(orient >= ORIENT_IDENTITY && orient < ORIENT_COUNT);
+    assert(!(orient & ORIENT_TRANSPOSE));
+
+    struct stat st;
+    if (fstat(fileno(in), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return 0;
+    }
+    off_t start = ftello(in);
+    struct header header;
+    read_header(in, &header);
+    if (!header.raw) {
+        fseeko(in, start, SEEK_SET);
+        return 0;
+    }
+
+    off_t raster = ftello(in);
+    size_t cellbytes = header.denominator < 256 ? 3 : 6;
+    size_t rowbytes = header.width * cellbytes;
+    if ((uintmax_t)(st.st_size - raster) / rowbytes < header.height) {
+        RAISE(Pnm_Badformat);
+    }
+
+    fprintf(out, "P6\n%u %u\n%u\n", header.width, header.height,
+            header.denominator);
+
+    unsigned char *band = malloc(rowbytes * BAND);
+    assert(band != NULL);
+    for (unsigned v0 = 0; v0 < header.height; v0 += BAND) {
+        unsigned rows = header.height - v0 < BAND ? header.height - v0
+                                                 : BAND;
+        unsigned y0 = (orient & ORIENT_FLIP_V) ? header.height - v0 - rows
+                                               : v0;
+        read_at(fileno(in), band, rows * rowbytes,
+                raster + (off_t)y0 * rowbytes);
+        for (unsigned k = 0; k < rows; k++) {
+            unsigned char *row = band + rowbytes *
+                                 ((orient & ORIENT_FLIP_V) ? rows - 1 - k
+                                                           : k);
+            if (orient & ORIENT_FLIP_H) {
+                reverse_cells(row, header.width, cellbytes);
+            }
+            size_t written = fwrite(row, 1, rowbytes, out);
+            assert(written == rowbytes);
+        }
+    }
+    free(band);
+
+    *width = header.width;
+    *height = header.height;
+    return 1;
+}
+
+/* Pixels of a plain raster decoded at a time by read_rows */
+#define DECODED 256
+
+/*
+ * read_rows
+ *
+ * Reads the next rows rows of the raster into band as packed samples,
+ * as they are in a binary file; plain rows are decoded and re-encoded,
+ * DECODED pixels at a time, so that no more memory than band is needed.
+ */
+static void read_rows(FILE *fp, const struct header *header, size_t rows,
+                      unsigned char *band)
+{
+    size_t count = rows * header->width;
+    if (header->raw) {
+        size_t n = count * (header->denominator < 256 ? 3 : 6);
+        if (fread(band, 1, n, fp) != n) {
+            RAISE(Pnm_Badformat);
+        }
+    } else {
+        struct Pnm_rgb pixels[DECODED];
+        for (size_t k = 0; k < count; k += DECODED) {
+            size_t n = count - k < DECODED ? count - k : DECODED;
+            decode_band(fp, pixels, n);
+            band += encode_band(pixels, n, header->denominator, band);
+        }
+    }
+}
+
+/*
+ * spill_stripe
+ *
+ * Fills the destination blocks of stripe k, whose cells all come from
+ * the band of source rows y0 .. held in band. Along a row of a block the
+ * source moves by a fixed step: along a source column when transposing,
+ * along a source row otherwise, backwards when flipped horizontally.
+ */
+static void spill_stripe(UArray2d_T spill, Orient_T orient, int k,
+                         int srcwidth, int y0, const unsigned char *band,
+                         size_t cellbytes)
+{
+    int transposed = orient & ORIENT_TRANSPOSE;
+    int width = UArray2d_width(spill);
+    int height = UArray2d_height(spill);
+    int b = UArray2d_blocksize(spill);
+    int blocks = ((transposed ? height : width) + b - 1) / b;
+    Orient_T inverse = Orient_inverse(orient);
+    ptrdiff_t step = (transposed ? (ptrdiff_t)(srcwidth * cellbytes)
+                                 : (ptrdiff_t)cellbytes) *
+                     ((orient & ORIENT_FLIP_H) ? -1 : 1);
+
+    for (int j = 0; j < blocks; j++) {
+        int bx = transposed ? k : j;
+        int by = transposed ? j : k;
+        int cols = width - bx * b < b ? width - bx * b : b;
+        unsigned char *block = UArray2d_block(spill, bx, by, 1);
+        for (int r = 0; r < b && by * b + r < height; r++) {
+            int x = bx * b;
+            int y = by * b + r;
+            Orient_apply(inverse, width, height, &x, &y);
+            const unsigned char *s = band + ((size_t)(y - y0) * srcwidth +
+                                             x) * cellbytes;
+            unsigned char *d = block + (size_t)r * b * cellbytes;
+            for (int c = 0; c < cols; c++) {
+                memcpy(d, s, cellbytes);
+                d += cellbytes;
+                s += step;
+            }
+        }
+    }
+}
+
+/*
+ * Ppmio_transform_external
+ *
+ * Half the limit goes to the band (which doubles as the output stripe)
+ * and half to the block cache, and the blocksize is as large as lets a
+ * band of that many rows fit. The least that works is a blocksize of 1:
+ * a band of one row of the widest side, and a cache of as much.
+ */
+extern size_t Ppmio_transform_external(FILE *in, FILE *out,
+                                       Orient_T orient, size_t limit,
+                                       unsigned *width, unsigned *height)
+{
+    assert(in != NULL && out != NULL);
+    assert(width != NULL && height != NULL);
+    assert(orient >= ORIENT_IDENTITY && orient < ORIENT_COUNT);
+
+    struct header header;
+    read_header(in, &header);
+    int transposed = orient & ORIENT_TRANSPOSE;
+    int srcwidth = header.width;
+    int srcheight = header.height;
+    int dstwidth = transposed ? srcheight : srcwidth;
+    int dstheight = transposed ? srcwidth : srcheight;
+    int widest = srcwidth > dstwidth ? srcwidth : dstwidth;
+    size_t cellbytes = header.denominator < 256 ? 3 : 6;
+
+    *width = header.width;
+    *height = header.height;
+    size_t least = 2 * (size_t)widest * cellbytes;
+    if (limit < least) {
+        return least;
+    }
+
+    size_t rows_fit = limit / 2 / ((size_t)widest * cellbytes);
+    int b = rows_fit > (size_t)widest ? widest : (int)rows_fit;
+    UArray2d_T spill = UArray2d_new(dstwidth, dstheight, cellbytes, b,
+                                    limit / 2);
+    unsigned char *band = malloc((size_t)b * widest * cellbytes);
+    assert(band != NULL);
+
+    /* source rows come in order; the stripes they fill may not */
+    int flip = orient & (transposed ? ORIENT_FLIP_H : ORIENT_FLIP_V);
+    int stripes = (srcheight + b - 1) / b;
+    for (int i = 0; i < stripes; i++) {
+        int k = flip ? stripes - 1 - i : i;
+        int d0 = k * b;
+        int d1 = srcheight - d0 < b ? srcheight : d0 + b;
+        read_rows(in, &header, d1 - d0, band);
+        spill_stripe(spill, orient, k, srcwidth,
+                     flip ? srcheight - d1 : d0, band, cellbytes);
+    }
+
+    /* then the output, a block row at a time */
+    fprintf(out, "P6\n%d %d\n%u\n", dstwidth, dstheight,
+            header.denominator);
+    size_t rowbytes = (size_t)dstwidth * cellbytes;
+    for (int v0 = 0; v0 < dstheight; v0 += b) {
+        int rows = dstheight - v0 < b ? dstheight - v0 : b;
+        for (int u0 = 0; u0 < dstwidth; u0 += b) {
+            int cols = dstwidth - u0 < b ? dstwidth - u0 : b;
+            const unsigned char *block = UArray2d_block(spill, u0 / b,
+                                                        v0 / b, 0);
+            for (int r = 0; r < rows; r++) {
+                memcpy(band + r * rowbytes + u0 * cellbytes,
+                       block + (size_t)r * b * cellbytes, cols * cellbytes);
+            }
+        }
+        size_t n = rows * rowbytes;
+        size_t written = fwrite(band, 1, n, out);
+        assert(written == n);
+    }
+
+    free(band);
+    UArray2d_free(&spill);
+    return 0;
+}
+
+/*
+ * copy_in_kernel
+ *
+ * Moves n bytes at offset in the regular file in to out without them
+ * passing through user space: copy_file_range where both ends are
+ * regular files, sendfile where out is anything else. Returns how many
+ * bytes were moved, which falls short only if the kernel will not do
+ * it for these descriptors.
+ */
+static size_t copy_in_kernel(int in, off_t offset, int out, size_t n)
+{
+    size_t done = 0;
+#ifdef __linux__
+    int use_sendfile = 0;
+    while (done < n) {
+        ssize_t k = use_sendfile ? sendfile(out, in, &offset, n - done)
+                                 : copy_file_range(in, &offset, out, NULL,
+                                                   n - done, 0);
+        if (k < 0 && !use_sendfile && done == 0) {
+            use_sendfile = 1;
+            continue;
+        }
+        if (k <= 0) {
+            break;
+        }
+        done += k;
+    }
+#else
+    (void)in;
+    (void)offset;
+    (void)out;
+    (void)n;
+#endif
+    return done;
+}
+
+/*
+ * Ppmio_copy
+ *
+ * Only the header is parsed. A binary raster from a regular file goes
+ * through the kernel; from anything else, or if the kernel will not
+ * copy between these descriptors, it goes through a BATCH-byte buffer
+ * without being decoded. A plain raster has to be decoded, but only a
+ * band of rows at a time.
+ */
+extern void Ppmio_copy(FILE *in, FILE *out, unsigned *width,
+                       unsigned *height)
+{
+    assert(in != NULL && out != NULL);
+    assert(width != NULL && height != NULL);
+
+    struct header header;
+    read_header(in, &header);
+    size_t cellbytes = header.denominator < 256 ? 3 : 6;
+    size_t rowbytes = header.width * cellbytes;
+    uintmax_t n = (uintmax_t)rowbytes * header.height;
+
+    fprintf(out, "P6\n%u %u\n%u\n", header.width, header.height,
+            header.denominator);
+    fflush(out);
+    int infd = fileno(in);
+    int outfd = fileno(out);
+    unsigned char *buffer = Slab_alloc(BATCH, SLAB_PAGE);
+
+    struct stat st;
+    if (header.raw && outfd >= 0 && fstat(infd, &st) == 0 &&
+        S_ISREG(st.st_mode)) {
+        off_t raster = ftello(in);
+        if ((uintmax_t)(st.st_size - raster) < n) {
+            Slab_free(buffer);
+            RAISE(Pnm_Badformat);
+        }
+        off_t offset = raster + copy_in_kernel(infd, raster, outfd, n);
+        while (offset < raster + (off_t)n) {
+            size_t k = raster + (off_t)n - offset < BATCH
+                           ? (size_t)(raster + (off_t)n - offset) : BATCH;
+            read_at(infd, buffer, k, offset);
+            struct iovec iov = { buffer, k };
+            write_all(outfd, &iov, 1);
+            offset += k;
+        }
+        fseeko(in, offset, SEEK_SET);
+    } else if (header.raw) {
+        while (n > 0) {
+            size_t k = n < BATCH ? n : BATCH;
+            if (fread(buffer, 1, k, in) != k) {
+                Slab_free(buffer);
+                RAISE(Pnm_Badformat);
+            }
+            size_t written = fwrite(buffer, 1, k, out);
+            assert(written == k);
+            n -= k;
+        }
+    } else {
+        size_t rows = BATCH / rowbytes < 1 ? 1 : BATCH / rowbytes;
+        unsigned char *band = malloc(rows * rowbytes);
+        assert(band != NULL);
+        for (unsigned y = 0; y < header.height; y += rows) {
+            size_t k = header.height - y < rows ? header.height - y : rows;
+            read_rows(in, &header, k, band);
+            size_t written = fwrite(band, 1, k * rowbytes, out);
+            assert(written == k * rowbytes);
+        }
+        free(band);
+    }
+    Slab_free(buffer);
+
+    *width = header.width;
+    *height = header.height;
+}
@@ -0,0 +1,164 @@
+/*
+ * ppmio.h
+ *
+ * Interface to our own PPM input and output, which know about
+ * orientations, views (see a2view.h), and storage layouts.
+ *
+ * Pnm_ppmwrite asks for every pixel by its position in the image;
+ * Ppmio_write instead materializes a band of rows at a time, reading
+ * the array underneath in whatever order is cheapest for its layout,
+ * and hands the encoded raster to the kernel in large batches.
+ * Ppmio_read_packed reads a band of rows at a time and scatters it
+ * straight to where an orientation sends it, so an image can be
+ * transformed as it is read, keeping its pixels packed as they are in
+ * the raster; Ppmio_read_planar splits them into planes instead (see
+ * planar.h). Ppmio_stream flips or turns a binary PPM file by 180
+ * degrees without reading it into memory at all, and
+ * Ppmio_transform_external does any orientation within a memory limit,
+ * spilling to a temporary file. Ppmio_copy writes an image out
+ * unchanged, leaving the raster undecoded where it can.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef PPMIO_INCLUDED
+#define PPMIO_INCLUDED
+
+#include <stdio.h>
+
+#include "a2methods.h"
+#include "pnm.h"
+#include "orient.h"
+#include "planar.h"
+
+/*
+ * Ppmio_packed_size
+ *
+ * The size of a packed pixel: the pixel as it is in a binary PPM raster,
+ * 3 bytes (a byte per sample) if denominator is below 256, otherwise 6
+ * (two bytes per sample, most significant first).
+ */
+extern size_t Ppmio_packed_size(unsigned denominator);
+
+/*
+ * Ppmio_read_packed
+ *
+ * Reads a PPM (plain or binary) from fp into a new array of methods
+ * holding the image as it would be after orient: what Pnm_ppmread
+ * followed by the transform would give, without the untransformed copy.
+ * The cells of the array are packed pixels rather than struct Pnm_rgb,
+ * which cuts the memory and bandwidth an image takes by 2 to 4 times.
+ * Such an image can be transformed and written with Ppmio_write like
+ * any other, but its cells are bytes, not samples.
+ *
+ * Returns: the image, to be freed with Pnm_ppmfree.
+ *
+ * Expectations: fp and methods are not NULL and orient is an orientation
+ *               (CREs). Raises Pnm_Badformat if fp does not hold a PPM.
+ */
+extern Pnm_ppm Ppmio_read_packed(FILE *fp, A2Methods_T methods,
+                                 Orient_T orient);
+
+/*
+ * Ppmio_read_planar
+ *
+ * Like Ppmio_read_packed, but into a planar image (see planar.h) whose
+ * planes are arrays of methods: each band of pixels is split into its
+ * red, green, and blue samples and each plane put where orient sends
+ * it, in the same pass. The image's denominator is stored in
+ * *denominator.
+ *
+ * Returns: the image, to be freed with Planar_free.
+ *
+ * Expectations: fp, methods, and denominator are not NULL and orient is
+ *               an orientation (CREs). Raises Pnm_Badformat if fp does
+ *               not hold a PPM.
+ */
+extern Planar_T Ppmio_read_planar(FILE *fp, A2Methods_T methods,
+                                  Orient_T orient, unsigned *denominator);
+
+/*
+ * Ppmio_write
+ *
+ * Writes ppm to fp as a binary (P6) PPM, as Pnm_ppmwrite would. The
+ * pixels may be any A2Methods array of struct Pnm_rgb or of packed
+ * pixels (see Ppmio_packed_size), including a view.
+ *
+ * Expectations: fp and ppm are not NULL, and ppm's methods, dimensions,
+ *               and pixels agree (CREs).
+ */
+extern void Ppmio_write(FILE *fp, Pnm_ppm ppm);
+
+/*
+ * Ppmio_write_planar
+ *
+ * Writes a planar image with the given denominator to fp as a binary
+ * PPM, merging its planes back into pixels a band at a time.
+ *
+ * Expectations: fp and planar are not NULL, and the size of planar's
+ *               samples suits denominator (CREs).
+ */
+extern void Ppmio_write_planar(FILE *fp, Planar_T planar,
+                               unsigned denominator);
+
+/*
+ * Ppmio_stream
+ *
+ * Writes the binary PPM in the regular file in to out under orient,
+ * reading the rows it needs straight from the file, so that memory use
+ * is a band of rows however large the image is.
+ *
+ * Returns: 1 if the image was written, with its dimensions stored in
+ *          *width and *height; 0 if in is not a regular file or does
+ *          not hold a binary (P6) PPM, in which case nothing was written
+ *          and in is back where it was, ready for another reader.
+ *
+ * Expectations: in, out, width, and height are not NULL and orient does
+ *               not transpose (CREs). Raises Pnm_Badformat if in does
+ *               not hold a PPM, or holds a truncated one.
+ */
+extern int Ppmio_stream(FILE *in, FILE *out, Orient_T orient,
+                        unsigned *width, unsigned *height);
+
+/*
+ * Ppmio_transform_external
+ *
+ * Writes the PPM read from in (plain or binary, from a file or a pipe)
+ * to out as a binary PPM under orient, using about limit bytes of memory
+ * however large the image is. The oriented image is built on disk, in a
+ * temporary file as big as the image, and written out from there.
+ *
+ * Parameters: the input and output, the orientation, the memory limit
+ *             in bytes, and where to store the image's dimensions.
+ *
+ * Returns: 0 once the image is written. If limit is below the least the
+ *          image can be done in, two rows' worth of pixels along its
+ *          wider side, nothing is written and that least is returned.
+ *
+ * Expectations: in, out, width, and height are not NULL and orient is
+ *               an orientation (CREs). Raises Pnm_Badformat if in does
+ *               not hold a PPM.
+ */
+extern size_t Ppmio_transform_external(FILE *in, FILE *out,
+                                       Orient_T orient, size_t limit,
+                                       unsigned *width, unsigned *height);
+
+/*
+ * Ppmio_copy
+ *
+ * Writes the PPM read from in (plain or binary, from a file or a pipe)
+ * to out as a binary PPM, unchanged: the identity transform. Only the
+ * header of a binary PPM is parsed; its raster is copied as it is, by
+ * the kernel when in is a regular file.
+ *
+ * Parameters: the input and output, and where to store the image's
+ *             dimensions.
+ *
+ * Expectations: in, out, width, and height are not NULL (CREs). Raises
+ *               Pnm_Badformat if in does not hold a PPM, or holds a
+ *               truncated one.
+ */
+extern void Ppmio_copy(FILE *in, FILE *out, unsigned *width,
+                       unsigned *height);
+
+#endif
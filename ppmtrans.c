@@ -9,13 +9,25 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2morton.h"
+#include "a2view.h"
 #include "pnm.h"
 #include "cputiming.h"
+#include "kernels.h"
+#include "orient.h"
+#include "ppmio.h"
+#include "planar.h"
+#include "pool.h"
+#include "numa.h"
+#include "slab.h"
+#include "tune.h"
 
 struct Package {
         A2Methods_T methods;
@@ -37,8 +49,11 @@ struct Package {
 
 /* Define the functions we use in this program */
 Pnm_ppm rotate_file(Pnm_ppm ppm_original, A2Methods_T methods, 
-                    A2Methods_mapfun *map, int rotation, struct Package *mail, 
-                    CPUTime_T timer, double *time_taken, char flip_value);
+                    A2Methods_mapfun *map, Orient_T orient, 
+                    struct Package *mail, CPUTime_T timer, 
+                    double *time_taken, size_t *huge, int inplace);
+Pnm_ppm view_file(Pnm_ppm ppm_original, A2Methods_T methods,
+                  Orient_T orient);
 void rotate90(int i, int j, A2Methods_UArray2 ppm_original, void *elem, 
               void *cl);
 void rotate180(int i, int j, A2Methods_UArray2 ppm_original, void *elem, 
@@ -51,8 +66,10 @@ void flip_vertical(int i, int j, A2Methods_UArray2 ppm_original, void *elem,
                      void *cl);
 void transpose (int i, int j, A2Methods_UArray2 ppm_original, void *elem,
                      void *cl);
-void timing_output(Pnm_ppm my_ppm_original, double time_taken, 
-                   FILE *timings_fp, A2Methods_T methods);
+void transverse(int i, int j, A2Methods_UArray2 ppm_original, void *elem,
+                void *cl);
+void timing_output(unsigned width, unsigned height, double time_taken, 
+                   size_t huge, FILE *timings_fp);
 
 /* Print a message to the user indicating the correct usage of the 
    executable */
@@ -60,11 +77,102 @@ static void
 usage(const char *progname)
 {
         fprintf(stderr, "Usage: %s [-rotate <angle>] "
-                        "[-{row,col,block}-major] [filename]\n",
+                        "[-flip {horizontal,vertical}] [-transpose] ... "
+                        "[-{row,col,block,morton}-major | -tiles <w>x<h>] "
+                        "[-inplace | -lazy | -on-read | -mem-limit <bytes> |"
+                        " -stream] "
+                        "[-planar] [-threads <n> [-numa]] [-calibrate] "
+                        "[filename]\n",
                         progname);
         exit(1);
 }
 
+/*
+ * parse_size
+ * 
+ * Reads a size in bytes, optionally followed by K, M, or G (powers of
+ * 1024). Returns 0 if text is not such a size.
+ */
+static size_t parse_size(const char *text)
+{
+        char *end;
+        unsigned long long n = strtoull(text, &end, 10);
+        int shift = 0;
+        if (end == text || *text == '-') {
+                return 0;
+        }
+        switch (*end) {
+        case 'K': case 'k': shift = 10; end++; break;
+        case 'M': case 'm': shift = 20; end++; break;
+        case 'G': case 'g': shift = 30; end++; break;
+        }
+        if (*end != '\0' || n > (SIZE_MAX >> shift)) {
+                return 0;
+        }
+        return (size_t)n << shift;
+}
+
+/* The wall-clock time the last timer ran, in nanoseconds */
+static struct timespec wall_start;
+static double wall_taken = 0;
+
+/*
+ * start_timer, stop_timer
+ * 
+ * CPUTime_Start and CPUTime_Stop, also noting the wall-clock time in
+ * between for timing_output: with a pool, CPU time is summed over every
+ * thread and so says nothing of how long the transform took. If huge is
+ * not NULL, stop_timer stores in it how much memory is on huge pages
+ * (see slab.h), taken there because the arrays are still live then.
+ */
+static void start_timer(CPUTime_T timer)
+{
+        clock_gettime(CLOCK_MONOTONIC, &wall_start);
+        CPUTime_Start(timer);
+}
+
+static double stop_timer(CPUTime_T timer, size_t *huge)
+{
+        double time_taken = CPUTime_Stop(timer);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        wall_taken = (now.tv_sec - wall_start.tv_sec) * 1e9 +
+                     (now.tv_nsec - wall_start.tv_nsec);
+        if (huge != NULL) {
+                *huge = Slab_huge_bytes();
+        }
+        return time_taken;
+}
+
+/*
+ * free_pool
+ * 
+ * Stops the workers of the default pool, if there is one, at exit.
+ */
+static void free_pool(void)
+{
+        Pool_T pool = Pool_default();
+        if (pool != NULL) {
+                Pool_free(&pool);
+        }
+}
+
+/*
+ * report_pages
+ * 
+ * Tells stderr which NUMA nodes the cells of array landed on, if the
+ * kernels know where they are.
+ */
+static void report_pages(const char *label, A2Methods_T methods,
+                         A2Methods_UArray2 array)
+{
+        void *base;
+        size_t bytes;
+        if (Kernels_storage(methods, array, &base, &bytes)) {
+                Numa_report(stderr, label, base, bytes);
+        }
+}
+
 /*
  * main
  * 
@@ -93,7 +201,18 @@ int main(int argc, char *argv[])
         FILE *fp = NULL;
         FILE *timings_fp = NULL;
         char *flip_direction = NULL;
-        char flip_value = 'r';
+        int inplace = 0;
+        int lazy = 0;
+        int on_read = 0;
+        int stream = 0;
+        int planar = 0;
+        int threads = 1;
+        int numa = 0;
+        int calibrate = 0;
+        size_t mem_limit = 0;
+
+        /* every -rotate, -flip, and -transpose composes onto this */
+        Orient_T orient = ORIENT_IDENTITY;
 
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-row-major") == 0) {
@@ -105,11 +224,30 @@ int main(int argc, char *argv[])
                 } else if (strcmp(argv[i], "-block-major") == 0) {
                         SET_METHODS(uarray2_methods_blocked, map_block_major,
                                     "block-major");
+                } else if (strcmp(argv[i], "-tiles") == 0) {
+                        if (!(i + 1 < argc)) {      /* no shape */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        long w = strtol(argv[++i], &endptr, 10);
+                        long h = *endptr == 'x' ? strtol(endptr + 1, &endptr,
+                                                         10) : 0;
+                        if (*endptr != '\0' || w < 1 || w > 4096 ||
+                            h < 1 || h > 4096) {
+                                fprintf(stderr, "Tiles must be given as "
+                                        "<width>x<height>, like 16x64\n");
+                                usage(argv[0]);
+                        }
+                        SET_METHODS(uarray2_methods_blocked, map_block_major,
+                                    "block-major");
+                        Tune_set_tiles(w, h);
+                } else if (strcmp(argv[i], "-morton-major") == 0) {
+                        SET_METHODS(uarray2_methods_morton, map_default,
+                                    "morton-major");
                 } else if (strcmp(argv[i], "-rotate") == 0) {
                         if (!(i + 1 < argc)) {      /* no rotate value */
                                 usage(argv[0]);
                         }
-                        flip_value = 'r';
                         char *endptr;
                         rotation = strtol(argv[++i], &endptr, 10);
                         if (!(rotation == 0 || rotation == 90 ||
@@ -121,21 +259,61 @@ int main(int argc, char *argv[])
                         if (!(*endptr == '\0')) {    /* Not a number */
                                 usage(argv[0]);
                         }
+                        orient = Orient_compose(orient,
+                                                Orient_rotation(rotation));
                 } else if (strcmp(argv[i], "-flip") == 0) {
                         if (!(i + 1 < argc)) {      /* no rotate value */
                                 usage(argv[0]);
                         }
                         flip_direction = argv[++i];
                         if (strcmp(flip_direction, "horizontal") == 0) {
-                                flip_value = 'h';
+                                orient = Orient_compose(orient,
+                                                        ORIENT_FLIP_H);
                         } else if (strcmp(flip_direction, "vertical") == 0) {
-                                flip_value = 'v';
+                                orient = Orient_compose(orient,
+                                                        ORIENT_FLIP_V);
                         } else {
                                 fprintf(stderr,"Invalid options\n");
                                 usage(argv[0]);
                         }
                 } else if (strcmp(argv[i], "-transpose") == 0) {
-                        flip_value = 't'; 
+                        orient = Orient_compose(orient, ORIENT_TRANSPOSE);
+                } else if (strcmp(argv[i], "-inplace") == 0) {
+                        inplace = 1;
+                } else if (strcmp(argv[i], "-lazy") == 0) {
+                        lazy = 1;
+                } else if (strcmp(argv[i], "-on-read") == 0) {
+                        on_read = 1;
+                } else if (strcmp(argv[i], "-stream") == 0) {
+                        stream = 1;
+                } else if (strcmp(argv[i], "-planar") == 0) {
+                        planar = 1;
+                } else if (strcmp(argv[i], "-threads") == 0) {
+                        if (!(i + 1 < argc)) {      /* no count */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        long n = strtol(argv[++i], &endptr, 10);
+                        if (*endptr != '\0' || n < 1 || n > 1024) {
+                                fprintf(stderr, "Thread count must be "
+                                        "between 1 and 1024\n");
+                                usage(argv[0]);
+                        }
+                        threads = n;
+                } else if (strcmp(argv[i], "-numa") == 0) {
+                        numa = 1;
+                } else if (strcmp(argv[i], "-calibrate") == 0) {
+                        calibrate = 1;
+                } else if (strcmp(argv[i], "-mem-limit") == 0) {
+                        if (!(i + 1 < argc)) {      /* no limit */
+                                usage(argv[0]);
+                        }
+                        mem_limit = parse_size(argv[++i]);
+                        if (mem_limit == 0) {
+                                fprintf(stderr, "Memory limit must be a "
+                                        "positive size, like 512M\n");
+                                usage(argv[0]);
+                        }
                 } else if (strcmp(argv[i], "-time") == 0) {
                         time_file_name = argv[++i];
                         timings_fp = fopen(time_file_name, "a");
@@ -157,6 +335,33 @@ int main(int argc, char *argv[])
                 }
         }
 
+        if (planar && lazy) {
+                fprintf(stderr, "-lazy does not work with -planar\n");
+                usage(argv[0]);
+        }
+
+        /* block sizes are timed on this machine before any array is made */
+        if (calibrate) {
+                Tune_calibrate(stderr);
+        }
+
+        /* the transform runs on a pool, with the parallel twin of the map */
+        if (threads > 1) {
+                Pool_T pool = Pool_new(threads);
+                if (numa) {
+                        Pool_spread(pool);
+                }
+                Pool_set_default(pool);
+                atexit(free_pool);
+                if (map == methods->map_row_major &&
+                    methods->map_row_major_parallel != NULL) {
+                        map = methods->map_row_major_parallel;
+                } else if (map == methods->map_block_major &&
+                           methods->map_block_major_parallel != NULL) {
+                        map = methods->map_block_major_parallel;
+                }
+        }
+
         if (fp == NULL) {
                 fp = stdin;
                 if (fp == NULL) {
@@ -165,25 +370,172 @@ int main(int argc, char *argv[])
                 }
         }
 
-        /* instance of ppm stores the original image */
-        Pnm_ppm my_ppm_original =  Pnm_ppmread(fp, methods);
+        /* no change at all: the raster is copied, never decoded */
+        if (orient == ORIENT_IDENTITY) {
+                CPUTime_T timer = CPUTime_New();
+                assert(timer != NULL);
+                unsigned width, height;
+                start_timer(timer);
+                Ppmio_copy(fp, stdout, &width, &height);
+                size_t huge = 0;
+                double time_taken = stop_timer(timer, timings_fp != NULL
+                                                      ? &huge : NULL);
+                CPUTime_Free(&timer);
+                if (timings_fp != NULL) {
+                        timing_output(width, height, time_taken, huge,
+                                      timings_fp);
+                }
+                fclose(fp);
+                return EXIT_SUCCESS;
+        }
+
+        /*
+         * flips and 180 degrees of a P6 file need only a band of rows, if
+         * asked for: the array is never built, so the layout, -threads,
+         * and -tiles do not apply, and -time counts the reading and
+         * writing too
+         */
+        if (stream && !(orient & ORIENT_TRANSPOSE) && !inplace && !lazy &&
+            !on_read && !planar) {
+                CPUTime_T timer = CPUTime_New();
+                assert(timer != NULL);
+                unsigned width, height;
+                start_timer(timer);
+                int streamed = Ppmio_stream(fp, stdout, orient, &width,
+                                            &height);
+                size_t huge = 0;
+                double time_taken = stop_timer(timer, timings_fp != NULL
+                                                      ? &huge : NULL);
+                CPUTime_Free(&timer);
+                if (streamed) {
+                        if (timings_fp != NULL) {
+                                timing_output(width, height, time_taken,
+                                              huge, timings_fp);
+                        }
+                        fclose(fp);
+                        return EXIT_SUCCESS;
+                }
+        }
+
+        /* anything else, within a memory limit, goes through a file */
+        if (mem_limit > 0 && !inplace && !lazy && !on_read && !planar) {
+                CPUTime_T timer = CPUTime_New();
+                assert(timer != NULL);
+                unsigned width, height;
+                start_timer(timer);
+                size_t least = Ppmio_transform_external(fp, stdout, orient,
+                                                        mem_limit, &width,
+                                                        &height);
+                size_t huge = 0;
+                double time_taken = stop_timer(timer, timings_fp != NULL
+                                                      ? &huge : NULL);
+                CPUTime_Free(&timer);
+                if (least > 0) {
+                        fprintf(stderr, "A %ux%u image needs a memory "
+                                "limit of at least %zu bytes\n", width,
+                                height, least);
+                        fclose(fp);
+                        return EXIT_FAILURE;
+                }
+                if (timings_fp != NULL) {
+                        timing_output(width, height, time_taken, huge,
+                                      timings_fp);
+                }
+                fclose(fp);
+                return EXIT_SUCCESS;
+        }
+
+        /* three planes, transformed one after another (or as read) */
+        if (planar) {
+                CPUTime_T timer = CPUTime_New();
+                assert(timer != NULL);
+                unsigned denominator;
+                Planar_T image;
+                if (on_read) {
+                        start_timer(timer);
+                        image = Ppmio_read_planar(fp, methods, orient,
+                                                  &denominator);
+                } else {
+                        image = Ppmio_read_planar(fp, methods,
+                                                  ORIENT_IDENTITY,
+                                                  &denominator);
+                        start_timer(timer);
+                        Planar_transform(image, map, orient, inplace);
+                }
+                size_t huge = 0;
+                double time_taken = stop_timer(timer, timings_fp != NULL
+                                                      ? &huge : NULL);
+                CPUTime_Free(&timer);
+                if (timings_fp != NULL) {
+                        timing_output(Planar_width(image),
+                                      Planar_height(image), time_taken,
+                                      huge, timings_fp);
+                }
+                if (numa) {
+                        const char *names[] = { "red", "green", "blue" };
+                        for (int p = PLANAR_RED; p <= PLANAR_BLUE; p++) {
+                                report_pages(names[p], Planar_methods(image),
+                                             Planar_plane(image, p));
+                        }
+                }
+                Ppmio_write_planar(stdout, image, denominator);
+                Planar_free(&image);
+                fclose(fp);
+                return EXIT_SUCCESS;
+        }
+
+        /* transformed on the way in: the original is never stored */
+        if (on_read) {
+                CPUTime_T timer = CPUTime_New();
+                assert(timer != NULL);
+                start_timer(timer);
+                Pnm_ppm ppm_final = Ppmio_read_packed(fp, methods, orient);
+                size_t huge = 0;
+                double time_taken = stop_timer(timer, timings_fp != NULL
+                                                      ? &huge : NULL);
+                if (timings_fp != NULL) {
+                        timing_output(ppm_final->width, ppm_final->height,
+                                      time_taken, huge, timings_fp);
+                }
+                if (numa) {
+                        report_pages("image", methods, ppm_final->pixels);
+                }
+                Ppmio_write(stdout, ppm_final);
+                Pnm_ppmfree(&ppm_final);
+                CPUTime_Free(&timer);
+                fclose(fp);
+                return EXIT_SUCCESS;
+        }
+
+        /* instance of ppm stores the original image, as packed pixels */
+        Pnm_ppm my_ppm_original = Ppmio_read_packed(fp, methods,
+                                                     ORIENT_IDENTITY);
 
         /* variables for timing */
         double time_taken;
         double *time_taken_ptr = &time_taken;
 
-        /* if rotating 0 degrees */
-        if (rotation == 0 && flip_value == 'r') {
-            Pnm_ppmwrite(stdout, my_ppm_original);
-            *time_taken_ptr = 0;
-            /* if there is a timing file provided */
-             if (timings_fp != NULL) {
-                timing_output(my_ppm_original, time_taken, timings_fp, 
-                              methods);
-              }
-            Pnm_ppmfree(&my_ppm_original);
-            fclose(fp);
-            return EXIT_SUCCESS;
+        /* a lazy transform is a view, materialized as it is written */
+        if (lazy) {
+                CPUTime_T timer = CPUTime_New();
+                assert(timer != NULL);
+                Pnm_ppm ppm_view = view_file(my_ppm_original, methods,
+                                             orient);
+                start_timer(timer);
+                Ppmio_write(stdout, ppm_view);
+                size_t huge = 0;
+                time_taken = stop_timer(timer, timings_fp != NULL ? &huge
+                                                                  : NULL);
+                if (timings_fp != NULL) {
+                        timing_output(my_ppm_original->width,
+                                      my_ppm_original->height, time_taken,
+                                      huge, timings_fp);
+                }
+                Pnm_ppmfree(&ppm_view);
+                Pnm_ppmfree(&my_ppm_original);
+                CPUTime_Free(&timer);
+                fclose(fp);
+                return EXIT_SUCCESS;
         }
 
         /* struct that's 'mailed' to each apply 
@@ -197,18 +549,30 @@ int main(int argc, char *argv[])
         /* declares a final ppm object that's updated in rotate_file 
         and finally returned */
         Pnm_ppm ppm_final;
-        ppm_final = rotate_file(my_ppm_original,methods, map, rotation, 
-                                mail, timer, time_taken_ptr, flip_value);
+        size_t huge = 0;
+        ppm_final = rotate_file(my_ppm_original, methods, map, orient, 
+                                mail, timer, time_taken_ptr,
+                                timings_fp != NULL ? &huge : NULL, inplace);
         if (timings_fp != NULL) {
-                timing_output(my_ppm_original, time_taken, timings_fp,
-                methods);
+                timing_output(my_ppm_original->width, 
+                              my_ppm_original->height, time_taken,
+                              huge, timings_fp);
+        }
+        if (numa) {
+                report_pages("source", methods, my_ppm_original->pixels);
+                if (ppm_final != my_ppm_original) {
+                        report_pages("result", methods, ppm_final->pixels);
+                }
         }
 
         /* writes to standard output */
-        Pnm_ppmwrite(stdout, ppm_final);
+        Ppmio_write(stdout, ppm_final);
 
 
-        Pnm_ppmfree(&ppm_final);
+        /* the final image may be the original, transformed in place */
+        if (ppm_final != my_ppm_original) {
+                Pnm_ppmfree(&ppm_final);
+        }
         Pnm_ppmfree(&my_ppm_original);
         free(mail);
 
@@ -221,21 +585,36 @@ int main(int argc, char *argv[])
 /*
  * rotate_file
  * 
- * Acts as a liason to all the mapping apply functions that rotate 90 degrees,
- * rotate 180 degrees, rotate 270 degrees, flip horizontally, flip vertically,
- * and transpose the original image
+ * Acts as a liason to all the transformations: rotate 90 degrees,
+ * rotate 180 degrees, rotate 270 degrees, flip horizontally, flip
+ * vertically, transpose, and transverse the original image - whatever
+ * single orientation the command line options add up to, applied in one
+ * pass. The work is done by the
+ * specialized kernel for the image's layout (see kernels.h), chosen once
+ * per image; suites without kernels fall back to mapping the apply
+ * function for the transformation over every pixel.
  * 
- * Returns: A Pnm_ppm object with the final object
+ * Flips and the 180 degree turn need no second image: they are done in
+ * place in ppm_original whenever a kernel can, which halves peak memory.
+ * With inplace set, so are the transposing orientations (90, 270, and
+ * transpose); that is slower, but fits images of which only one copy
+ * fits in memory.
  * 
- * Parameters: the width and height of the pixel, the two-dimensional array
- *             holding the original iamge, the current element, and the closure
- *             argument
+ * Returns: A Pnm_ppm object with the final object, which is ppm_original
+ *          itself if it was transformed in place
  * 
- * Expectations: i, j are in-bounds. ppm_original is a valid non-null UArray2. 
+ * Parameters: the original image, the methods and map to use, the
+ *             (non-identity) orientation to apply, the package for the apply
+ *             functions, the timer and where to store its reading and
+ *             (unless NULL) the bytes on huge pages (see stop_timer), and
+ *             whether to transpose in place
+ * 
+ * Expectations: ppm_original is a valid non-null Pnm_ppm. 
  */
 Pnm_ppm rotate_file(Pnm_ppm ppm_original, A2Methods_T methods, 
-                    A2Methods_mapfun *map, int rotation, struct Package *mail,
-                    CPUTime_T timer, double *time_taken, char flip_value) 
+                    A2Methods_mapfun *map, Orient_T orient, 
+                    struct Package *mail, CPUTime_T timer, 
+                    double *time_taken, size_t *huge, int inplace) 
 {
       assert(mail != NULL);
       assert(ppm_original != NULL);  
@@ -244,6 +623,36 @@ Pnm_ppm rotate_file(Pnm_ppm ppm_original, A2Methods_T methods,
       assert(map != NULL);
       assert(timer != NULL);
 
+      assert(orient > ORIENT_IDENTITY && orient < ORIENT_COUNT);
+
+      /* the apply function to fall back on, for each orientation */
+      static A2Methods_applyfun *const applies[ORIENT_COUNT] = {
+                [ORIENT_TRANSPOSE]  = transpose,
+                [ORIENT_FLIP_H]     = flip_horizontal,
+                [ORIENT_ROT90]      = rotate90,
+                [ORIENT_FLIP_V]     = flip_vertical,
+                [ORIENT_ROT270]     = rotate270,
+                [ORIENT_ROT180]     = rotate180,
+                [ORIENT_TRANSVERSE] = transverse,
+      };
+      A2Methods_applyfun *apply = applies[orient];
+
+      /* flips and 180 degrees (and all else if asked) swap pixels where 
+         they lie if they can */
+      if (inplace || !(orient & ORIENT_TRANSPOSE)) {
+                start_timer(timer);
+                if (Kernels_transform_inplace(methods, ppm_original->pixels,
+                                              orient)) {
+                        *time_taken = stop_timer(timer, huge);
+                        if (orient & ORIENT_TRANSPOSE) {
+                                unsigned width = ppm_original->width;
+                                ppm_original->width = ppm_original->height;
+                                ppm_original->height = width;
+                        }
+                        return ppm_original;
+                }
+      }
+
       /* malloc the final ppm object to be returned*/
       Pnm_ppm ppm_final = malloc(sizeof(*ppm_final));
       assert(ppm_final != NULL);
@@ -252,64 +661,69 @@ Pnm_ppm rotate_file(Pnm_ppm ppm_original, A2Methods_T methods,
       ppm_final->denominator = ppm_original->denominator;
       int size = methods->size(ppm_original->pixels);
 
-      if ((rotation == 90 || rotation == 270) && flip_value == 'r') {
+      /* transposing orientations swap the dimensions */
+      if (orient & ORIENT_TRANSPOSE) {
                 ppm_final->width = ppm_original->height;
                 ppm_final->height = ppm_original->width;
-                ppm_final->pixels = methods->new(ppm_final->width,
-                                                 ppm_final->height, size); 
-                mail->finaluarr = ppm_final->pixels;
-                if (rotation == 90) {
-                        CPUTime_Start(timer);
-                        map(ppm_original->pixels, rotate90, mail);
-                        *time_taken = CPUTime_Stop(timer);
-                } else {
-                        CPUTime_Start(timer);
-                        map(ppm_original->pixels, rotate270, mail); 
-                        *time_taken = CPUTime_Stop(timer);
-                }
-      } else if (rotation == 180 && flip_value == 'r') {
+      } else {
                 ppm_final->width = ppm_original->width;
                 ppm_final->height = ppm_original->height;
-                ppm_final->pixels = methods->new(ppm_final->width,
-                                                 ppm_final->height, size); 
-                mail->finaluarr = ppm_final->pixels;
-
-                CPUTime_Start(timer);
-                map(ppm_original->pixels, rotate180, mail);
-                *time_taken = CPUTime_Stop(timer);
-        /* flip vertically or horizontally */
-      } else if (flip_value == 'v' || flip_value == 'h') {
-               ppm_final->width = ppm_original->width;
-               ppm_final->height = ppm_original->height;
-               ppm_final->pixels = methods->new(ppm_final->width,
-                                                 ppm_final->height, size); 
-               mail->finaluarr = ppm_final->pixels;
-               if (flip_value == 'v') {
-                     CPUTime_Start(timer);
-                     map(ppm_original->pixels, flip_vertical, mail);
-                     *time_taken = CPUTime_Stop(timer);
-               } else if (flip_value == 'h') {
-                    CPUTime_Start(timer);
-                     map(ppm_original->pixels, flip_horizontal, mail);
-                     *time_taken = CPUTime_Stop(timer);
-               }
-        /* transpose the image */
-      } else if (flip_value == 't') {
-                ppm_final->width = ppm_original->height;
-                ppm_final->height = ppm_original->width;
-                ppm_final->pixels = methods->new(ppm_final->width,
-                                                 ppm_final->height, size); 
-                mail->finaluarr = ppm_final->pixels;
-
-                CPUTime_Start(timer);
-                map(ppm_original->pixels, transpose, mail);
-                *time_taken = CPUTime_Stop(timer);
       }
+      ppm_final->pixels = methods->new(ppm_final->width,
+                                       ppm_final->height, size); 
+      mail->finaluarr = ppm_final->pixels;
+
+      start_timer(timer);
+      if (!Kernels_transform(methods, map, ppm_original->pixels,
+                             ppm_final->pixels, orient)) {
+                map(ppm_original->pixels, apply, mail);
+      }
+      *time_taken = stop_timer(timer, huge);
+
       ppm_final->methods = ppm_original->methods;
 
       return ppm_final;
 }
 
+/*
+ * view_file
+ * 
+ * Wraps ppm_original in a view of it under orient (see a2view.h): no
+ * pixel is moved until the view is written out, and no second image is
+ * ever allocated.
+ * 
+ * Returns: A Pnm_ppm object whose pixels are the view. Freeing it frees
+ *          the view only; ppm_original must outlive it.
+ * 
+ * Parameters: the original image, its methods, and the (non-identity)
+ *             orientation to apply
+ * 
+ * Expectations: ppm_original is a valid non-null Pnm_ppm. 
+ */
+Pnm_ppm view_file(Pnm_ppm ppm_original, A2Methods_T methods,
+                  Orient_T orient)
+{
+      assert(ppm_original != NULL);
+      assert(methods != NULL);
+
+      Pnm_ppm ppm_view = malloc(sizeof(*ppm_view));
+      assert(ppm_view != NULL);
+      ppm_view->denominator = ppm_original->denominator;
+      if (orient & ORIENT_TRANSPOSE) {
+                ppm_view->width = ppm_original->height;
+                ppm_view->height = ppm_original->width;
+      } else {
+                ppm_view->width = ppm_original->width;
+                ppm_view->height = ppm_original->height;
+      }
+      ppm_view->pixels = A2View_new(methods, ppm_original->pixels, orient,
+                                    0, 0, ppm_view->width,
+                                    ppm_view->height);
+      ppm_view->methods = uarray2_methods_view;
+
+      return ppm_view;
+}
+
 /*
  * rotate90
  * 
@@ -332,7 +746,8 @@ void rotate90(int i, int j, A2Methods_UArray2 ppm_original, void *elem,
        A2Methods_UArray2 *UArray2_new = ((struct Package *)cl)->finaluarr;
        A2Methods_T methods = ((struct Package *)cl)->methods;
        int col = methods->width(UArray2_new) - j - 1;
-       *(Pnm_rgb)methods->at(UArray2_new, col, i) = *(Pnm_rgb)elem;
+       memcpy(methods->at(UArray2_new, col, i), elem,
+              methods->size(UArray2_new));
 }
 
 /*
@@ -358,7 +773,8 @@ void rotate180(int i, int j, A2Methods_UArray2 ppm_original, void *elem,
        A2Methods_T methods_temp = ((struct Package *)cl)->methods;
        int col = methods_temp->width(UArray_temp) - i - 1;
        int row = methods_temp->height(UArray_temp) - j - 1;
-       *(Pnm_rgb)methods_temp->at(UArray_temp, col, row) = *(Pnm_rgb)elem;
+       memcpy(methods_temp->at(UArray_temp, col, row), elem,
+              methods_temp->size(UArray_temp));
 
 }
 
@@ -384,7 +800,8 @@ void rotate270(int i, int j, A2Methods_UArray2 ppm_original, void *elem,
        A2Methods_UArray2 *UArray2_new = ((struct Package *)cl)->finaluarr;
        A2Methods_T methods = ((struct Package *)cl)->methods;
        int row = methods->height(UArray2_new) - i - 1;
-       *(Pnm_rgb)methods->at(UArray2_new, j, row) = *(Pnm_rgb)elem;
+       memcpy(methods->at(UArray2_new, j, row), elem,
+              methods->size(UArray2_new));
 
 }
 
@@ -410,7 +827,8 @@ void flip_horizontal(int i, int j, A2Methods_UArray2 ppm_original, void *elem,
        A2Methods_UArray2 *UArray_temp = ((struct Package *)cl)->finaluarr;
        A2Methods_T methods_temp = ((struct Package *)cl)->methods;
        int col = methods_temp->width(UArray_temp) - i - 1;
-       *(Pnm_rgb)methods_temp->at(UArray_temp, col, j) = *(Pnm_rgb)elem;
+       memcpy(methods_temp->at(UArray_temp, col, j), elem,
+              methods_temp->size(UArray_temp));
   
 }
 
@@ -436,7 +854,8 @@ void flip_vertical(int i, int j, A2Methods_UArray2 ppm_original, void *elem,
        A2Methods_UArray2 *UArray_temp = ((struct Package *)cl)->finaluarr;
        A2Methods_T methods_temp = ((struct Package *)cl)->methods;
        int row = methods_temp->height(UArray_temp) - j - 1;
-       *(Pnm_rgb)methods_temp->at(UArray_temp, i, row) = *(Pnm_rgb)elem;
+       memcpy(methods_temp->at(UArray_temp, i, row), elem,
+              methods_temp->size(UArray_temp));
 
 }
 
@@ -461,32 +880,70 @@ void transpose (int i, int j, A2Methods_UArray2 ppm_original, void *elem,
 
        A2Methods_UArray2 *UArray_temp = ((struct Package *)cl)->finaluarr;
        A2Methods_T methods_temp = ((struct Package *)cl)->methods;
-       *(Pnm_rgb)methods_temp->at(UArray_temp, j, i) = *(Pnm_rgb)elem;
+       memcpy(methods_temp->at(UArray_temp, j, i), elem,
+              methods_temp->size(UArray_temp));
+
+}
+
+/*
+ * transverse
+ * 
+ * Transposes image across upper-right to lower-left axis
+ * 
+ * Parameters: the width and height of the pixel, the two-dimensional array
+ *             holding the original iamge, the current element, and the closure
+ *             argument
+ * 
+ * Expectations: i, j are in-bounds. ppm_original is a valid non-null UArray2. 
+ */
+void transverse(int i, int j, A2Methods_UArray2 ppm_original, void *elem,
+                void *cl)
+{
+       assert(elem != NULL);
+       assert (cl != NULL);
+       assert(ppm_original != NULL); 
+       (void) ppm_original;
+
+       A2Methods_UArray2 *UArray_temp = ((struct Package *)cl)->finaluarr;
+       A2Methods_T methods_temp = ((struct Package *)cl)->methods;
+       int col = methods_temp->width(UArray_temp) - j - 1;
+       int row = methods_temp->height(UArray_temp) - i - 1;
+       memcpy(methods_temp->at(UArray_temp, col, row), elem,
+              methods_temp->size(UArray_temp));
 
 }
 
 /*
  * timing_output
  * 
- * Produces timing output for the file operations
+ * Produces timing output for the file operations, and says whether the
+ * images ended up on huge pages (see slab.h). The time taken is CPU
+ * time; with a pool of threads the wall-clock time is given as well.
  * 
- * Parameters: the original ppm file, the time taken, the file to
- *             which timing output is written, and the A2Methods_T object.
+ * Parameters: the dimensions of the image, the time taken, the bytes
+ *             on huge pages while the images were live (see stop_timer),
+ *             and the file to which timing output is written.
  * 
  * Expectations: all parameters passed in are valid. 
  */
-void timing_output(Pnm_ppm my_ppm_original, double time_taken, 
-                   FILE *timings_fp, A2Methods_T methods) {
-        assert(my_ppm_original != NULL);
-        assert(methods != NULL);
+void timing_output(unsigned width, unsigned height, double time_taken, 
+                   size_t huge, FILE *timings_fp) {
         assert(timings_fp != NULL);
 
-        int width_count = methods->width(my_ppm_original->pixels);
-        int height_count = methods->height(my_ppm_original->pixels);
-        int pixel_count = width_count * height_count;
+        double pixel_count = (double)width * height;
         double time_per_pixel = time_taken/pixel_count;
 
         fprintf(timings_fp, "Total Time Taken: %f\n", time_taken);
         fprintf(timings_fp, "Time Per Pixel: %f\n", time_per_pixel); 
+        if (Pool_default() != NULL) {
+                fprintf(timings_fp, "Wall Time Taken: %f\n", wall_taken);
+                fprintf(timings_fp, "Wall Time Per Pixel: %f\n",
+                        wall_taken / pixel_count);
+        }
+        if (huge > 0) {
+                fprintf(timings_fp, "Huge Pages: yes, %zu KB\n", huge >> 10);
+        } else {
+                fprintf(timings_fp, "Huge Pages: no\n");
+        }
         fclose(timings_fp);
-}
\ No newline at end of file
+}
@@ -0,0 +1,358 @@
+/*
+ * samples.c
+ *
+ * The sample converters. Each has a scalar loop, which also finishes
+ * whatever is left over, and an SSE2 version; Samples_narrow8 also has
+ * an AVX2 version, picked at run time. The splits and merges between
+ * pixels and planes are byte shuffles, done with SSSE3 where the
+ * processor has it.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#include <pthread.h>
+
+#include "samples.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+#ifdef HAVE_SSE2
+
+/*
+ * What the CPU supports, found once: the converters run on the pool's
+ * threads (see pool.h), so the first calls may come from several at once
+ */
+static pthread_once_t detected = PTHREAD_ONCE_INIT;
+static int avx2, ssse3;
+
+static void detect(void)
+{
+    avx2 = __builtin_cpu_supports("avx2");
+    ssse3 = __builtin_cpu_supports("ssse3");
+}
+
+static int has_avx2(void)
+{
+    pthread_once(&detected, detect);
+    return avx2;
+}
+
+/* The low bytes of 16 unsigned ints, in order */
+static inline __m128i narrowed(const unsigned *src)
+{
+    __m128i mask = _mm_set1_epi32(0xff);
+    __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)src), mask);
+    __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + 4)),
+                              mask);
+    __m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + 8)),
+                              mask);
+    __m128i d = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + 12)),
+                              mask);
+    return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+}
+
+/* The low halves of 8 unsigned ints, big-endian, in order */
+static inline __m128i narrowed16(const unsigned *src)
+{
+    /* sign-extending the low half lets the signed pack keep it exact */
+    __m128i a = _mm_loadu_si128((const __m128i *)src);
+    __m128i b = _mm_loadu_si128((const __m128i *)(src + 4));
+    a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+    b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+    __m128i words = _mm_packs_epi32(a, b);
+    return _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+}
+
+__attribute__((target("avx2")))
+static size_t narrow8_avx2(const unsigned *src, unsigned char *dst,
+                           size_t count)
+{
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t k = 0;
+    for (; k + 32 <= count; k += 32) {
+        __m256i v[4];
+        for (int i = 0; i < 4; i++) {
+            v[i] = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)
+                                                       (src + k + 8 * i)),
+                                    mask);
+        }
+        /* the packs work within lanes; the permute puts them in order */
+        __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(v[0], v[1]),
+                                            _mm256_packs_epi32(v[2], v[3]));
+        _mm256_storeu_si256((__m256i *)(dst + k),
+                            _mm256_permutevar8x32_epi32(bytes, order));
+    }
+    return k;
+}
+
+/*
+ * pshufb masks. split[p][v] picks plane p's samples out of the v-th of
+ * three input vectors; merge[v][p] places plane p's samples in the v-th
+ * output vector. Z zeroes a byte. The 16-bit masks also swap the bytes
+ * of each sample between big-endian and the machine's order.
+ */
+#define Z -128
+
+static const signed char split8[3][3][16] = {
+    {
+        { 0, 3, 6, 9, 12, 15, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, Z, 2, 5, 8, 11, 14, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 1, 4, 7, 10, 13 },
+    },
+    {
+        { 1, 4, 7, 10, 13, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, 0, 3, 6, 9, 12, 15, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 2, 5, 8, 11, 14 },
+    },
+    {
+        { 2, 5, 8, 11, 14, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, 1, 4, 7, 10, 13, Z, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 0, 3, 6, 9, 12, 15 },
+    },
+};
+
+static const signed char merge8[3][3][16] = {
+    {
+        { 0, Z, Z, 1, Z, Z, 2, Z, Z, 3, Z, Z, 4, Z, Z, 5 },
+        { Z, 0, Z, Z, 1, Z, Z, 2, Z, Z, 3, Z, Z, 4, Z, Z },
+        { Z, Z, 0, Z, Z, 1, Z, Z, 2, Z, Z, 3, Z, Z, 4, Z },
+    },
+    {
+        { Z, Z, 6, Z, Z, 7, Z, Z, 8, Z, Z, 9, Z, Z, 10, Z },
+        { 5, Z, Z, 6, Z, Z, 7, Z, Z, 8, Z, Z, 9, Z, Z, 10 },
+        { Z, 5, Z, Z, 6, Z, Z, 7, Z, Z, 8, Z, Z, 9, Z, Z },
+    },
+    {
+        { Z, 11, Z, Z, 12, Z, Z, 13, Z, Z, 14, Z, Z, 15, Z, Z },
+        { Z, Z, 11, Z, Z, 12, Z, Z, 13, Z, Z, 14, Z, Z, 15, Z },
+        { 10, Z, Z, 11, Z, Z, 12, Z, Z, 13, Z, Z, 14, Z, Z, 15 },
+    },
+};
+
+static const signed char split16[3][3][16] = {
+    {
+        { 1, 0, 7, 6, 13, 12, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, Z, 3, 2, 9, 8, 15, 14, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 5, 4, 11, 10 },
+    },
+    {
+        { 3, 2, 9, 8, 15, 14, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, Z, 5, 4, 11, 10, Z, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 1, 0, 7, 6, 13, 12 },
+    },
+    {
+        { 5, 4, 11, 10, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, 1, 0, 7, 6, 13, 12, Z, Z, Z, Z, Z, Z },
+        { Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 3, 2, 9, 8, 15, 14 },
+    },
+};
+
+static const signed char merge16[3][3][16] = {
+    {
+        { 1, 0, Z, Z, Z, Z, 3, 2, Z, Z, Z, Z, 5, 4, Z, Z },
+        { Z, Z, 1, 0, Z, Z, Z, Z, 3, 2, Z, Z, Z, Z, 5, 4 },
+        { Z, Z, Z, Z, 1, 0, Z, Z, Z, Z, 3, 2, Z, Z, Z, Z },
+    },
+    {
+        { Z, Z, 7, 6, Z, Z, Z, Z, 9, 8, Z, Z, Z, Z, 11, 10 },
+        { Z, Z, Z, Z, 7, 6, Z, Z, Z, Z, 9, 8, Z, Z, Z, Z },
+        { 5, 4, Z, Z, Z, Z, 7, 6, Z, Z, Z, Z, 9, 8, Z, Z },
+    },
+    {
+        { Z, Z, Z, Z, 13, 12, Z, Z, Z, Z, 15, 14, Z, Z, Z, Z },
+        { 11, 10, Z, Z, Z, Z, 13, 12, Z, Z, Z, Z, 15, 14, Z, Z },
+        { Z, Z, 11, 10, Z, Z, Z, Z, 13, 12, Z, Z, Z, Z, 15, 14 },
+    },
+};
+
+#undef Z
+
+static int has_ssse3(void)
+{
+    pthread_once(&detected, detect);
+    return ssse3;
+}
+
+/*
+ * split_ssse3, merge_ssse3
+ *
+ * 16 / width pixels (48 bytes) at a time, for samples width bytes wide.
+ * Return how many pixels they did.
+ */
+__attribute__((target("ssse3")))
+static size_t split_ssse3(const unsigned char *src, unsigned char *planes[3],
+                          size_t count, const signed char masks[3][3][16],
+                          size_t width)
+{
+    __m128i m[3][3];
+    for (int p = 0; p < 3; p++) {
+        for (int v = 0; v < 3; v++) {
+            m[p][v] = _mm_loadu_si128((const __m128i *)masks[p][v]);
+        }
+    }
+    size_t step = 16 / width;
+    size_t k = 0;
+    for (; k + step <= count; k += step) {
+        const unsigned char *s = src + 3 * width * k;
+        __m128i a = _mm_loadu_si128((const __m128i *)s);
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+        for (int p = 0; p < 3; p++) {
+            __m128i v = _mm_or_si128(_mm_shuffle_epi8(a, m[p][0]),
+                                     _mm_shuffle_epi8(b, m[p][1]));
+            v = _mm_or_si128(v, _mm_shuffle_epi8(c, m[p][2]));
+            _mm_storeu_si128((__m128i *)(planes[p] + width * k), v);
+        }
+    }
+    return k;
+}
+
+__attribute__((target("ssse3")))
+static size_t merge_ssse3(unsigned char *const planes[3], unsigned char *dst,
+                          size_t count, const signed char masks[3][3][16],
+                          size_t width)
+{
+    __m128i m[3][3];
+    for (int v = 0; v < 3; v++) {
+        for (int p = 0; p < 3; p++) {
+            m[v][p] = _mm_loadu_si128((const __m128i *)masks[v][p]);
+        }
+    }
+    size_t step = 16 / width;
+    size_t k = 0;
+    for (; k + step <= count; k += step) {
+        size_t at = width * k;
+        __m128i r = _mm_loadu_si128((const __m128i *)(planes[0] + at));
+        __m128i g = _mm_loadu_si128((const __m128i *)(planes[1] + at));
+        __m128i b = _mm_loadu_si128((const __m128i *)(planes[2] + at));
+        unsigned char *d = dst + 3 * width * k;
+        for (int v = 0; v < 3; v++) {
+            __m128i out = _mm_or_si128(_mm_shuffle_epi8(r, m[v][0]),
+                                       _mm_shuffle_epi8(g, m[v][1]));
+            out = _mm_or_si128(out, _mm_shuffle_epi8(b, m[v][2]));
+            _mm_storeu_si128((__m128i *)(d + 16 * v), out);
+        }
+    }
+    return k;
+}
+
+#endif
+
+extern void Samples_narrow8(const unsigned *src, unsigned char *dst,
+                            size_t count)
+{
+    size_t k = 0;
+#ifdef HAVE_SSE2
+    if (has_avx2()) {
+        k = narrow8_avx2(src, dst, count);
+    }
+    for (; k + 16 <= count; k += 16) {
+        _mm_storeu_si128((__m128i *)(dst + k), narrowed(src + k));
+    }
+#endif
+    for (; k < count; k++) {
+        dst[k] = src[k];
+    }
+}
+
+extern void Samples_narrow16(const unsigned *src, unsigned char *dst,
+                             size_t count)
+{
+    size_t k = 0;
+#ifdef HAVE_SSE2
+    for (; k + 8 <= count; k += 8) {
+        _mm_storeu_si128((__m128i *)(dst + 2 * k), narrowed16(src + k));
+    }
+#endif
+    for (; k < count; k++) {
+        dst[2 * k] = src[k] >> 8;
+        dst[2 * k + 1] = src[k];
+    }
+}
+
+extern void Samples_split8(const unsigned char *src, unsigned char *red,
+                           unsigned char *green, unsigned char *blue,
+                           size_t count)
+{
+    unsigned char *planes[3] = { red, green, blue };
+    size_t k = 0;
+#ifdef HAVE_SSE2
+    if (has_ssse3()) {
+        k = split_ssse3(src, planes, count, split8, 1);
+    }
+#endif
+    for (; k < count; k++) {
+        red[k] = src[3 * k];
+        green[k] = src[3 * k + 1];
+        blue[k] = src[3 * k + 2];
+    }
+}
+
+extern void Samples_split16(const unsigned char *src, uint16_t *red,
+                            uint16_t *green, uint16_t *blue, size_t count)
+{
+    unsigned char *planes[3] = { (unsigned char *)red,
+                                 (unsigned char *)green,
+                                 (unsigned char *)blue };
+    size_t k = 0;
+#ifdef HAVE_SSE2
+    if (has_ssse3()) {
+        k = split_ssse3(src, planes, count, split16, 2);
+    }
+#endif
+    for (; k < count; k++) {
+        const unsigned char *s = src + 6 * k;
+        red[k] = s[0] << 8 | s[1];
+        green[k] = s[2] << 8 | s[3];
+        blue[k] = s[4] << 8 | s[5];
+    }
+}
+
+extern void Samples_merge8(const unsigned char *red,
+                           const unsigned char *green,
+                           const unsigned char *blue, unsigned char *dst,
+                           size_t count)
+{
+    size_t k = 0;
+#ifdef HAVE_SSE2
+    if (has_ssse3()) {
+        unsigned char *const planes[3] = { (unsigned char *)red,
+                                           (unsigned char *)green,
+                                           (unsigned char *)blue };
+        k = merge_ssse3(planes, dst, count, merge8, 1);
+    }
+#endif
+    for (; k < count; k++) {
+        dst[3 * k] = red[k];
+        dst[3 * k + 1] = green[k];
+        dst[3 * k + 2] = blue[k];
+    }
+}
+
+extern void Samples_merge16(const uint16_t *red, const uint16_t *green,
+                            const uint16_t *blue, unsigned char *dst,
+                            size_t count)
+{
+    size_t k = 0;
+#ifdef HAVE_SSE2
+    if (has_ssse3()) {
+        unsigned char *const planes[3] = { (unsigned char *)red,
+                                           (unsigned char *)green,
+                                           (unsigned char *)blue };
+        k = merge_ssse3(planes, dst, count, merge16, 2);
+    }
+#endif
+    for (; k < count; k++) {
+        unsigned char *d = dst + 6 * k;
+        d[0] = red[k] >> 8;
+        d[1] = red[k];
+        d[2] = green[k] >> 8;
+        d[3] = green[k];
+        d[4] = blue[k] >> 8;
+        d[5] = blue[k];
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * samples.h
+ *
+ * Interface to the sample converters: bulk conversion from the unsigned
+ * ints of struct Pnm_rgb to the packed samples of a binary PPM raster
+ * (one byte each when the denominator is below 256, otherwise two, most
+ * significant first). A run of Pnm_rgb pixels is a run of unsigned
+ * samples in raster order, so this is plain narrowing of an array, done
+ * with SSE2 or AVX2 a register at a time. Packed pixels can also be
+ * split into planes, one per channel, and merged back.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef SAMPLES_INCLUDED
+#define SAMPLES_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Samples_narrow8, Samples_narrow16
+ *
+ * Convert count unsigned ints at src to packed samples at dst, keeping
+ * the low byte, or the low two bytes most significant first, of each.
+ *
+ * Expectations: the buffers do not overlap.
+ */
+extern void Samples_narrow8(const unsigned *src, unsigned char *dst,
+                            size_t count);
+extern void Samples_narrow16(const unsigned *src, unsigned char *dst,
+                             size_t count);
+
+/*
+ * Samples_split8, Samples_split16
+ *
+ * Split count packed pixels at src, three samples each as above, into
+ * planes of red, green, and blue samples: bytes, or 16-bit ints in the
+ * machine's byte order.
+ *
+ * Expectations: no two buffers overlap.
+ */
+extern void Samples_split8(const unsigned char *src, unsigned char *red,
+                           unsigned char *green, unsigned char *blue,
+                           size_t count);
+extern void Samples_split16(const unsigned char *src, uint16_t *red,
+                            uint16_t *green, uint16_t *blue, size_t count);
+
+/*
+ * Samples_merge8, Samples_merge16
+ *
+ * The reverse: count samples from each of three planes, interleaved
+ * into packed pixels at dst.
+ *
+ * Expectations: no two buffers overlap.
+ */
+extern void Samples_merge8(const unsigned char *red,
+                           const unsigned char *green,
+                           const unsigned char *blue, unsigned char *dst,
+                           size_t count);
+extern void Samples_merge16(const uint16_t *red, const uint16_t *green,
+                            const uint16_t *blue, unsigned char *dst,
+                            size_t count);
+
+#endif
@@ -0,0 +1,184 @@
+/**************************************************************
+ *
+ *                     slab.c
+ *
+ *     Assignment: iii
+ *     Authors:  Jahansher Khan (jkhan03), Tom Barnett-Young (tbarne02)
+ *
+ *      Implementation of the slab allocator used for the element
+ *      storage of UArray2 and UArray2b.
+ *
+ **************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "pool.h"
+#include "slab.h"
+
+/*
+ * Every slab is preceded by two words: how many bytes were mapped for
+ * it (0 if it came from aligned_alloc) and where the allocation starts.
+ * The header takes a whole alignment unit, so the slab stays aligned.
+ */
+#define HEADER (2 * sizeof(size_t))
+
+/*
+ * thp_enabled
+ * 
+ * Whether the kernel will back memory with transparent huge pages when
+ * asked to (its mode is "always" or "madvise", not "never"); read once.
+ */
+static int thp_enabled(void)
+{
+    static int enabled = -1;
+    if (enabled < 0) {
+        char mode[128] = "";
+        FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled",
+                         "r");
+        if (fp != NULL) {
+            if (fgets(mode, sizeof(mode), fp) == NULL) {
+                mode[0] = '\0';
+            }
+            fclose(fp);
+        }
+        enabled = mode[0] != '\0' && strstr(mode, "[never]") == NULL;
+    }
+    return enabled;
+}
+
+/*
+ * map_huge
+ * 
+ * Maps *mapped bytes (a multiple of SLAB_PAGE) of zeroes on huge pages:
+ * reserved ones (MAP_HUGETLB) if the system has any to spare, in which
+ * case *mapped is rounded up to a whole number of them, otherwise a
+ * mapping aligned to SLAB_HUGE that the kernel is asked to back with
+ * transparent huge pages. Returns NULL if neither is to be had.
+ */
+static char *map_huge(size_t *mapped)
+{
+    size_t bytes = Slab_round(*mapped, SLAB_HUGE);
+    char *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED) {
+        *mapped = bytes;
+        return base;
+    }
+    if (!thp_enabled()) {
+        return NULL;
+    }
+
+    /* map a huge page too many, then trim to an aligned *mapped bytes */
+    char *raw = mmap(NULL, *mapped + SLAB_HUGE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    base = (char *)Slab_round((uintptr_t)raw, SLAB_HUGE);
+    if (base > raw) {
+        munmap(raw, base - raw);
+    }
+    munmap(base + *mapped, raw + SLAB_HUGE - base);
+    if (madvise(base, *mapped, MADV_HUGEPAGE) != 0) {
+        munmap(base, *mapped);
+        return NULL;
+    }
+    return base;
+}
+
+/*
+ * Slab_alloc
+ * 
+ * Returns a zero-filled block of at least bytes bytes whose address is
+ * a multiple of align. aligned_alloc wants a whole number of alignment
+ * units, so the request is rounded up (and never allowed to be 0).
+ * Slabs of SLAB_MAP bytes or more are mapped fresh from the kernel,
+ * already zero, on huge pages from SLAB_HUGE bytes if there are any,
+ * and their pages faulted in by the default pool (see Pool_touch), so
+ * that on a spread pool each band of the slab lands on the node of the
+ * thread that will work on it.
+ */
+void *Slab_alloc(size_t bytes, size_t align)
+{
+    assert(align > 0 && (align & (align - 1)) == 0);
+    size_t offset = align < HEADER ? HEADER : align;
+    bytes = Slab_round(bytes, align);
+    if (bytes == 0) {
+        bytes = align;
+    }
+
+    char *base = NULL;
+    size_t mapped = 0;
+    if (bytes >= SLAB_MAP && align <= SLAB_PAGE) {
+        mapped = Slab_round(offset + bytes, SLAB_PAGE);
+        if (bytes >= SLAB_HUGE) {
+            base = map_huge(&mapped);
+        }
+        if (base == NULL) {
+            base = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            assert(base != MAP_FAILED);
+        }
+    } else {
+        base = aligned_alloc(offset, Slab_round(offset + bytes, offset));
+        assert(base != NULL);
+        memset(base + offset, 0, bytes);
+    }
+
+    char *slab = base + offset;
+    ((size_t *)slab)[-1] = mapped;
+    ((char **)slab)[-2] = base;
+    if (mapped != 0) {
+        Pool_touch(Pool_default(), slab, bytes);
+    }
+    return slab;
+}
+
+/*
+ * Slab_free
+ * 
+ * Releases a slab returned by Slab_alloc.
+ */
+void Slab_free(void *slab)
+{
+    if (slab == NULL) {
+        return;
+    }
+    size_t mapped = ((size_t *)slab)[-1];
+    char *base = ((char **)slab)[-2];
+    if (mapped != 0) {
+        munmap(base, mapped);
+    } else {
+        free(base);
+    }
+}
+
+/*
+ * Slab_huge_bytes
+ * 
+ * Adds up the process's memory on huge pages, reserved or transparent,
+ * from the kernel's summary of its mappings.
+ */
+size_t Slab_huge_bytes(void)
+{
+    FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    char line[128];
+    size_t total = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        unsigned long kb;
+        if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+            sscanf(line, "Shared_Hugetlb: %lu kB", &kb) == 1 ||
+            sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1) {
+            total += (size_t)kb << 10;
+        }
+    }
+    fclose(fp);
+    return total;
+}
@@ -0,0 +1,73 @@
+/**************************************************************
+ *
+ *                     slab.h
+ *
+ *     Assignment: iii
+ *     Authors:  Jahansher Khan (jkhan03), Tom Barnett-Young (tbarne02)
+ *
+ *      Interface for the slab allocator shared by UArray2 and
+ *      UArray2b. A slab is one zero-filled, aligned allocation that
+ *      holds every element of an array.
+ *
+ **************************************************************/
+
+#ifndef __Slab__
+#define __Slab__
+
+#include <stddef.h>
+
+/* Alignment of a cache line and of a page, in bytes */
+#define SLAB_CACHE_LINE 64
+#define SLAB_PAGE       4096
+
+/* Size from which slabs are mapped from the kernel rather than allocated */
+#define SLAB_MAP        (1 << 20)
+
+/* Size of a huge page, and from which slabs are put on them */
+#define SLAB_HUGE       (2 << 20)
+
+/*
+ * Slab_round
+ * 
+ * Rounds bytes up to the next multiple of align.
+ * 
+ * Parameters: a byte count and an alignment, which must be a power of two.
+ */
+static inline size_t Slab_round(size_t bytes, size_t align)
+{
+    return (bytes + align - 1) & ~(align - 1);
+}
+
+/*
+ * Slab_alloc
+ * 
+ * Returns a zero-filled block of at least bytes bytes whose address is
+ * a multiple of align. A slab of SLAB_MAP bytes or more has its pages
+ * placed by the default pool, if that is spread over NUMA nodes (see
+ * Pool_touch in pool.h). One of SLAB_HUGE bytes or more is put on huge
+ * pages, which cut the TLB misses of walking an image across its rows,
+ * if the system has them; if not, it gets ordinary pages.
+ * 
+ * Parameters: the number of bytes wanted (may be 0) and the alignment,
+ *             which must be a power of two.
+ * 
+ * Expectations: running out of memory is a CRE.
+ */
+void *Slab_alloc(size_t bytes, size_t align);
+
+/*
+ * Slab_free
+ * 
+ * Releases a slab returned by Slab_alloc. A NULL slab is ignored.
+ */
+void Slab_free(void *slab);
+
+/*
+ * Slab_huge_bytes
+ * 
+ * Returns how many bytes of the process's memory are on huge pages at
+ * the moment: 0 when slabs had to fall back to ordinary ones.
+ */
+size_t Slab_huge_bytes(void);
+
+#endif
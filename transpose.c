@@ -0,0 +1,459 @@
+/*
+ * transpose.c
+ *
+ * The tiled transpose engine, for the 1- and 2-byte samples of planar
+ * images and the 3- and 6-byte pixels of packed ones.
+ *
+ * The tile is cut into OUTER x OUTER squares (so a source square and its
+ * destination fit in L2 together). A 16-byte register holds a whole run
+ * of 16 or 8 samples, so each square is cut in turn into squares of as
+ * many rows, loaded a register per row and transposed in registers with
+ * the classic unpack network. A packed pixel is three such samples: a
+ * run of 16 or 8 pixels is three registers, which SSSE3 byte shuffles
+ * split into a register per sample plane; the planes are transposed like
+ * planar samples and the shuffles put back together. With AVX2 each
+ * 128-bit lane does this for its own square, one above the other, so a
+ * micro tile is twice as tall. Whatever does not fill a micro tile is
+ * copied a cell at a time, as is all of a packed tile on CPUs without
+ * SSSE3.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "transpose.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+#define OUTER 64
+
+/*
+ * copy_scalar
+ *
+ * The engine's contract for a rectangle of the tile, one cell at a
+ * time. Used for the ragged edges and on CPUs without SSE2.
+ */
+static inline void copy_scalar(const char *src, ptrdiff_t srcpitch,
+                               int c0, int c1, int r0, int r1,
+                               char *dst, ptrdiff_t dstrow,
+                               ptrdiff_t dstcol, size_t size)
+{
+    for (int r = r0; r < r1; r++) {
+        const char *s = src + r * srcpitch + c0 * size;
+        char *d = dst + c0 * dstrow + r * dstcol;
+        for (int c = c0; c < c1; c++) {
+            memcpy(d, s, size);
+            s += size;
+            d += dstrow;
+        }
+    }
+}
+
+#ifdef HAVE_SSE2
+
+/* F(0) .. F(n - 1), spelled out so the registers below stay registers */
+#define REPEAT4(F, B) F((B) + 0) F((B) + 1) F((B) + 2) F((B) + 3)
+#define REPEAT8(F)    REPEAT4(F, 0) REPEAT4(F, 4)
+#define REPEAT16(F)   REPEAT8(F) REPEAT4(F, 8) REPEAT4(F, 12)
+
+/*
+ * micro1, micro2
+ *
+ * A square of n = 16 / size source rows by n source columns of size-
+ * byte cells, one register per row. log2(n) rounds of interleaving
+ * register i with register i + n / 2 a cell at a time, into registers
+ * 2i and 2i + 1, leave column k in register k, which is stored as
+ * destination run k.
+ */
+#define LOAD(N, I)                                                          \
+    x[I] = _mm_loadu_si128((const __m128i *)                                \
+               (s + (reverse ? (N) - 1 - (I) : (I)) * srcpitch));
+#define ROUND(N, LO, HI, X, Y, I)                                           \
+    Y[2 * (I)] = LO(X[I], X[(I) + (N) / 2]);                                \
+    Y[2 * (I) + 1] = HI(X[I], X[(I) + (N) / 2]);
+#define STORE(X, I) _mm_storeu_si128((__m128i *)(d + (I) * dstrow), X[I]);
+
+static inline void network1(__m128i x[16])
+{
+    __m128i y[16];
+#define A(I) ROUND(16, _mm_unpacklo_epi8, _mm_unpackhi_epi8, x, y, I)
+#define B(I) ROUND(16, _mm_unpacklo_epi8, _mm_unpackhi_epi8, y, x, I)
+    REPEAT8(A) REPEAT8(B) REPEAT8(A) REPEAT8(B)
+#undef A
+#undef B
+}
+
+static inline void network2(__m128i x[8])
+{
+    __m128i y[8];
+#define A(I) ROUND(8, _mm_unpacklo_epi16, _mm_unpackhi_epi16, x, y, I)
+#define B(I) ROUND(8, _mm_unpacklo_epi16, _mm_unpackhi_epi16, y, x, I)
+#define C(I) x[I] = y[I];
+    REPEAT4(A, 0) REPEAT4(B, 0) REPEAT4(A, 0)
+    REPEAT8(C)
+#undef A
+#undef B
+#undef C
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline void network1_avx2(__m256i x[16])
+{
+    __m256i y[16];
+#define A(I) ROUND(16, _mm256_unpacklo_epi8, _mm256_unpackhi_epi8, x, y, I)
+#define B(I) ROUND(16, _mm256_unpacklo_epi8, _mm256_unpackhi_epi8, y, x, I)
+    REPEAT8(A) REPEAT8(B) REPEAT8(A) REPEAT8(B)
+#undef A
+#undef B
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline void network2_avx2(__m256i x[8])
+{
+    __m256i y[8];
+#define A(I) ROUND(8, _mm256_unpacklo_epi16, _mm256_unpackhi_epi16, x, y, I)
+#define B(I) ROUND(8, _mm256_unpacklo_epi16, _mm256_unpackhi_epi16, y, x, I)
+#define C(I) x[I] = y[I];
+    REPEAT4(A, 0) REPEAT4(B, 0) REPEAT4(A, 0)
+    REPEAT8(C)
+#undef A
+#undef B
+#undef C
+}
+
+static inline void micro1(const char *src, ptrdiff_t srcpitch, int c,
+                          int r, char *dst, ptrdiff_t dstrow, int reverse)
+{
+    __m128i x[16];
+    const char *s = src + r * srcpitch + c;
+    char *d = dst + c * dstrow + (reverse ? -(r + 15) : r);
+#define L(I) LOAD(16, I)
+#define S(I) STORE(x, I)
+    REPEAT16(L)
+    network1(x);
+    REPEAT16(S)
+#undef L
+#undef S
+}
+
+static inline void micro2(const char *src, ptrdiff_t srcpitch, int c,
+                          int r, char *dst, ptrdiff_t dstrow, int reverse)
+{
+    __m128i x[8];
+    const char *s = src + r * srcpitch + c * 2;
+    char *d = dst + c * dstrow + (reverse ? -(r + 7) : r) * 2;
+#define L(I) LOAD(8, I)
+#define S(I) STORE(x, I)
+    REPEAT8(L)
+    network2(x);
+    REPEAT8(S)
+#undef L
+#undef S
+}
+
+#undef LOAD
+#undef ROUND
+#undef STORE
+
+/*
+ * What the CPU supports, found once along with the shuffle masks: the
+ * engine runs on the pool's threads (see pool.h), so the first calls may
+ * come from several at once
+ */
+static pthread_once_t detected = PTHREAD_ONCE_INIT;
+static int avx2, ssse3;
+
+/*
+ * split[w - 1][p][v]: picks the bytes of plane p (red, green, or blue)
+ * of a run of 48 bytes of pixels with w-byte samples out of its 16-byte
+ * part v, to their places in the plane's register. merge[w - 1][v][p]
+ * does the reverse, placing the bytes of plane p into part v.
+ */
+static signed char split[2][3][3][16], merge[2][3][3][16];
+
+static void detect(void)
+{
+    avx2 = __builtin_cpu_supports("avx2");
+    ssse3 = __builtin_cpu_supports("ssse3");
+    for (int w = 1; w <= 2; w++) {
+        for (int p = 0; p < 3; p++) {
+            for (int v = 0; v < 3; v++) {
+                for (int o = 0; o < 16; o++) {
+                    int from = o / w * 3 * w + p * w + o % w;
+                    split[w - 1][p][v][o] = from / 16 == v ? from % 16 
+                                                           : -128;
+                    int at = 16 * v + o;
+                    int plane = at % (3 * w) / w;
+                    merge[w - 1][v][p][o] = plane == p 
+                                            ? at / (3 * w) * w + at % w
+                                            : -128;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * micro_packed
+ *
+ * A square of n = 16 / w source rows by n source columns of pixels of
+ * three w-byte samples. Each row, three registers, is split into its
+ * planes; each plane is transposed as by micro1 or micro2, leaving
+ * column k of it in register k; and the three planes' registers k are
+ * merged into destination run k.
+ */
+__attribute__((target("ssse3"), always_inline))
+static inline void micro_packed(const char *src, ptrdiff_t srcpitch, int c,
+                                int r, char *dst, ptrdiff_t dstrow,
+                                int reverse, int w)
+{
+    int n = 16 / w;
+    __m128i x[3][16], m[3][3];
+    const char *s = src + c * 3 * w;
+    char *d = dst + c * dstrow + (reverse ? -(r + n - 1) : r) * 3 * w;
+
+    for (int p = 0; p < 3; p++) {
+        for (int v = 0; v < 3; v++) {
+            m[p][v] = _mm_loadu_si128((const __m128i *)split[w - 1][p][v]);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        const char *row = s + (reverse ? r + n - 1 - i : r + i) * srcpitch;
+        __m128i a = _mm_loadu_si128((const __m128i *)row);
+        __m128i b = _mm_loadu_si128((const __m128i *)(row + 16));
+        __m128i e = _mm_loadu_si128((const __m128i *)(row + 32));
+        for (int p = 0; p < 3; p++) {
+            x[p][i] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m[p][0]),
+                                                _mm_shuffle_epi8(b, m[p][1])),
+                                   _mm_shuffle_epi8(e, m[p][2]));
+        }
+    }
+    for (int p = 0; p < 3; p++) {
+        if (w == 1) {
+            network1(x[p]);
+        } else {
+            network2(x[p]);
+        }
+    }
+    for (int v = 0; v < 3; v++) {
+        for (int p = 0; p < 3; p++) {
+            m[v][p] = _mm_loadu_si128((const __m128i *)merge[w - 1][v][p]);
+        }
+    }
+    for (int k = 0; k < n; k++) {
+        for (int v = 0; v < 3; v++) {
+            __m128i out = _mm_or_si128(
+                _mm_or_si128(_mm_shuffle_epi8(x[0][k], m[v][0]),
+                             _mm_shuffle_epi8(x[1][k], m[v][1])),
+                _mm_shuffle_epi8(x[2][k], m[v][2]));
+            _mm_storeu_si128((__m128i *)(d + k * dstrow + 16 * v), out);
+        }
+    }
+}
+
+/*
+ * micro_packed_avx2
+ *
+ * Two squares of micro_packed at once, one in each 128-bit lane: the
+ * lanes hold source rows r .. r + n - 1 and r + n .. r + 2n - 1, whose
+ * columns become the two halves of destination runs of 2n pixels.
+ */
+__attribute__((target("avx2"), always_inline))
+static inline void micro_packed_avx2(const char *src, ptrdiff_t srcpitch,
+                                     int c, int r, char *dst,
+                                     ptrdiff_t dstrow, int reverse, int w)
+{
+    int n = 16 / w;
+    __m256i x[3][16], m[3][3];
+    const char *s = src + c * 3 * w;
+    char *d = dst + c * dstrow + (reverse ? -(r + 2 * n - 1) : r) * 3 * w;
+
+    for (int p = 0; p < 3; p++) {
+        for (int v = 0; v < 3; v++) {
+            m[p][v] = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128((const __m128i *)split[w - 1][p][v]));
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        int lo = reverse ? r + 2 * n - 1 - i : r + i;
+        int hi = reverse ? r + n - 1 - i : r + n + i;
+        __m256i part[3];
+        for (int v = 0; v < 3; v++) {
+            part[v] = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)
+                    (s + lo * srcpitch + 16 * v))),
+                _mm_loadu_si128((const __m128i *)
+                    (s + hi * srcpitch + 16 * v)), 1);
+        }
+        for (int p = 0; p < 3; p++) {
+            x[p][i] = _mm256_or_si256(
+                _mm256_or_si256(_mm256_shuffle_epi8(part[0], m[p][0]),
+                                _mm256_shuffle_epi8(part[1], m[p][1])),
+                _mm256_shuffle_epi8(part[2], m[p][2]));
+        }
+    }
+    for (int p = 0; p < 3; p++) {
+        if (w == 1) {
+            network1_avx2(x[p]);
+        } else {
+            network2_avx2(x[p]);
+        }
+    }
+    for (int v = 0; v < 3; v++) {
+        for (int p = 0; p < 3; p++) {
+            m[v][p] = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128((const __m128i *)merge[w - 1][v][p]));
+        }
+    }
+    for (int k = 0; k < n; k++) {
+        for (int v = 0; v < 3; v++) {
+            __m256i out = _mm256_or_si256(
+                _mm256_or_si256(_mm256_shuffle_epi8(x[0][k], m[v][0]),
+                                _mm256_shuffle_epi8(x[1][k], m[v][1])),
+                _mm256_shuffle_epi8(x[2][k], m[v][2]));
+            _mm_storeu_si128((__m128i *)(d + k * dstrow + 16 * v),
+                             _mm256_castsi256_si128(out));
+            _mm_storeu_si128((__m128i *)(d + k * dstrow + 48 + 16 * v),
+                             _mm256_extracti128_si256(out, 1));
+        }
+    }
+}
+
+/* The instances, one per pixel size and instruction set */
+__attribute__((target("ssse3")))
+static void micro3(const char *src, ptrdiff_t srcpitch, int c, int r,
+                   char *dst, ptrdiff_t dstrow, int reverse)
+{
+    micro_packed(src, srcpitch, c, r, dst, dstrow, reverse, 1);
+}
+
+__attribute__((target("ssse3")))
+static void micro6(const char *src, ptrdiff_t srcpitch, int c, int r,
+                   char *dst, ptrdiff_t dstrow, int reverse)
+{
+    micro_packed(src, srcpitch, c, r, dst, dstrow, reverse, 2);
+}
+
+__attribute__((target("avx2")))
+static void micro3_avx2(const char *src, ptrdiff_t srcpitch, int c, int r,
+                        char *dst, ptrdiff_t dstrow, int reverse)
+{
+    micro_packed_avx2(src, srcpitch, c, r, dst, dstrow, reverse, 1);
+}
+
+__attribute__((target("avx2")))
+static void micro6_avx2(const char *src, ptrdiff_t srcpitch, int c, int r,
+                        char *dst, ptrdiff_t dstrow, int reverse)
+{
+    micro_packed_avx2(src, srcpitch, c, r, dst, dstrow, reverse, 2);
+}
+
+typedef void microfun(const char *src, ptrdiff_t srcpitch, int c, int r,
+                      char *dst, ptrdiff_t dstrow, int reverse);
+
+/*
+ * packed_micro
+ *
+ * The micro tile copy for pixels of size bytes that the CPU supports,
+ * or NULL if it has none; *rows and *cols are set to its shape.
+ */
+static microfun *packed_micro(size_t size, int *rows, int *cols)
+{
+    pthread_once(&detected, detect);
+    *cols = 48 / size;
+    *rows = avx2 ? 2 * *cols : *cols;
+    if (avx2) {
+        return size == 3 ? micro3_avx2 : micro6_avx2;
+    } else if (ssse3) {
+        return size == 3 ? micro3 : micro6;
+    }
+    return NULL;
+}
+
+#endif
+
+/*
+ * tile
+ *
+ * The engine for cells of any size it knows: OUTER x OUTER squares, each
+ * cut into register-sized micro tiles (see micro1 and micro_packed) and
+ * ragged edges.
+ */
+static inline void tile(const char *src, ptrdiff_t srcpitch, int width,
+                        int height, char *dst, ptrdiff_t dstrow,
+                        int reverse, size_t size)
+{
+    ptrdiff_t dstcol = reverse ? -(ptrdiff_t)size : (ptrdiff_t)size;
+#ifdef HAVE_SSE2
+    int rows = 16 / size;
+    int cols = rows;
+    microfun *micro = NULL;
+    if (size % 3 == 0) {
+        micro = packed_micro(size, &rows, &cols);
+    }
+    if (size < 3 || micro != NULL) {
+        for (int r0 = 0; r0 < height; r0 += OUTER) {
+            int r1 = r0 + OUTER < height ? r0 + OUTER : height;
+            int rfull = r0 + (r1 - r0) / rows * rows;
+            for (int c0 = 0; c0 < width; c0 += OUTER) {
+                int c1 = c0 + OUTER < width ? c0 + OUTER : width;
+                int cfull = c0 + (c1 - c0) / cols * cols;
+                for (int r = r0; r < rfull; r += rows) {
+                    for (int c = c0; c < cfull; c += cols) {
+                        if (size == 1) {
+                            micro1(src, srcpitch, c, r, dst, dstrow,
+                                   reverse);
+                        } else if (size == 2) {
+                            micro2(src, srcpitch, c, r, dst, dstrow,
+                                   reverse);
+                        } else {
+                            micro(src, srcpitch, c, r, dst, dstrow,
+                                  reverse);
+                        }
+                    }
+                }
+                copy_scalar(src, srcpitch, cfull, c1, r0, rfull, dst,
+                            dstrow, dstcol, size);
+                copy_scalar(src, srcpitch, c0, c1, rfull, r1, dst, dstrow,
+                            dstcol, size);
+            }
+        }
+        return;
+    }
+#endif
+    copy_scalar(src, srcpitch, 0, width, 0, height, dst, dstrow, dstcol,
+                size);
+}
+
+extern void Transpose_tile1(const char *src, ptrdiff_t srcpitch,
+                            int width, int height,
+                            char *dst, ptrdiff_t dstrow, int reverse)
+{
+    tile(src, srcpitch, width, height, dst, dstrow, reverse, 1);
+}
+
+extern void Transpose_tile2(const char *src, ptrdiff_t srcpitch,
+                            int width, int height,
+                            char *dst, ptrdiff_t dstrow, int reverse)
+{
+    tile(src, srcpitch, width, height, dst, dstrow, reverse, 2);
+}
+
+extern void Transpose_tile3(const char *src, ptrdiff_t srcpitch,
+                            int width, int height,
+                            char *dst, ptrdiff_t dstrow, int reverse)
+{
+    tile(src, srcpitch, width, height, dst, dstrow, reverse, 3);
+}
+
+extern void Transpose_tile6(const char *src, ptrdiff_t srcpitch,
+                            int width, int height,
+                            char *dst, ptrdiff_t dstrow, int reverse)
+{
+    tile(src, srcpitch, width, height, dst, dstrow, reverse, 6);
+}
@@ -0,0 +1,49 @@
+/*
+ * transpose.h
+ *
+ * Interface to the tiled transpose engine for the 1- and 2-byte samples
+ * of planar images (see planar.h) and the 3- and 6-byte pixels of packed
+ * ones. Rotations by 90 and 270 degrees and transposition are all a
+ * transpose plus a reversal; the engine does both in one pass, moving
+ * small tiles through SSE2 registers (and SSSE3 shuffles, for packed
+ * pixels) and storing whole runs of destination cells at a time, inside
+ * an outer tiling sized for L2.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef TRANSPOSE_INCLUDED
+#define TRANSPOSE_INCLUDED
+
+#include <stddef.h>
+
+/*
+ * Transpose_tile1, Transpose_tile2, Transpose_tile3, Transpose_tile6
+ *
+ * Copy a width x height tile of cells of 1, 2, 3, or 6 bytes so that source
+ * cell (c, r), found at src + r * srcpitch + c * size, lands at
+ *
+ *     dst + c * dstrow + r * size          if reverse is 0
+ *     dst + c * dstrow - r * size          otherwise
+ *
+ * That is, each source column becomes one destination row, laid down
+ * left to right or right to left. dstrow may be negative, which reverses
+ * the order of the destination rows.
+ *
+ * Expectations: the tiles do not overlap. Uses SSE2 on x86 CPUs (SSSE3
+ *               for 3 and 6 bytes), and plain C elsewhere.
+ */
+extern void Transpose_tile1(const char *src, ptrdiff_t srcpitch,
+                            int width, int height,
+                            char *dst, ptrdiff_t dstrow, int reverse);
+extern void Transpose_tile2(const char *src, ptrdiff_t srcpitch,
+                            int width, int height,
+                            char *dst, ptrdiff_t dstrow, int reverse);
+extern void Transpose_tile3(const char *src, ptrdiff_t srcpitch,
+                            int width, int height,
+                            char *dst, ptrdiff_t dstrow, int reverse);
+extern void Transpose_tile6(const char *src, ptrdiff_t srcpitch,
+                            int width, int height,
+                            char *dst, ptrdiff_t dstrow, int reverse);
+
+#endif
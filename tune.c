@@ -0,0 +1,316 @@
+/*
+ * tune.c
+ *
+ * Implementation file for block tuning.
+ *
+ * The calibration image is big enough (18MB of packed pixels) that no
+ * cache below the last level holds it, and is rotated with the blocked
+ * kernels, on the calling thread alone, best of a few tries per budget.
+ * The saved file has a line "l1 l2 budget" per kind of machine.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "a2blocked.h"
+#include "cputiming.h"
+#include "kernels.h"
+#include "tune.h"
+#include "uarray2b.h"
+
+#define SMALLEST (4 << 10)      /* the candidate budgets */
+#define LARGEST  (1 << 20)
+
+#define LINE 64                 /* bytes in a cache line */
+
+#define SAMPLE_WIDTH  3072      /* the calibration image */
+#define SAMPLE_HEIGHT 2048
+#define SAMPLE_SIZE   3
+#define TRIES 5
+
+static size_t tuned = 0;        /* Tune_block_bytes, once worked out */
+static int tiles[2];            /* Tune_set_tiles, or 0 x 0 */
+
+/*
+ * sysfs_cache
+ *
+ * The size of the cache of cpu0 at level that holds data, from sysfs, or
+ * 0 if it is not listed.
+ */
+static size_t sysfs_cache(int level)
+{
+    for (int index = 0; index < 8; index++) {
+        char path[64], type[32];
+        int lvl;
+        unsigned long kb;
+        const char *dir = "/sys/devices/system/cpu/cpu0/cache";
+
+        snprintf(path, sizeof(path), "%s/index%d/level", dir, index);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+            break;
+        }
+        int ok = fscanf(fp, "%d", &lvl) == 1;
+        fclose(fp);
+
+        snprintf(path, sizeof(path), "%s/index%d/type", dir, index);
+        fp = fopen(path, "r");
+        ok = ok && fp != NULL && fscanf(fp, "%31s", type) == 1;
+        if (fp != NULL) {
+            fclose(fp);
+        }
+
+        snprintf(path, sizeof(path), "%s/index%d/size", dir, index);
+        fp = fopen(path, "r");
+        ok = ok && fp != NULL && fscanf(fp, "%luK", &kb) == 1;
+        if (fp != NULL) {
+            fclose(fp);
+        }
+
+        if (ok && lvl == level && strcmp(type, "Instruction") != 0) {
+            return (size_t)kb << 10;
+        }
+    }
+    return 0;
+}
+
+extern void Tune_caches(size_t *l1, size_t *l2)
+{
+    assert(l1 != NULL && l2 != NULL);
+    long n1 = -1, n2 = -1;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    n1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    n2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    *l1 = n1 > 0 ? (size_t)n1 : sysfs_cache(1);
+    *l2 = n2 > 0 ? (size_t)n2 : sysfs_cache(2);
+    if (*l1 == 0) {
+        *l1 = 32 << 10;
+    }
+    if (*l2 == 0) {
+        *l2 = 256 << 10;
+    }
+}
+
+/*
+ * cache_path
+ *
+ * Writes the path of the file of saved budgets into path, returning 0
+ * if there is no directory to put it in.
+ */
+static int cache_path(char *path, size_t room)
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int n;
+    if (xdg != NULL && *xdg != '\0') {
+        n = snprintf(path, room, "%s/ppmtrans-blocks", xdg);
+    } else if (home != NULL && *home != '\0') {
+        n = snprintf(path, room, "%s/.cache/ppmtrans-blocks", home);
+    } else {
+        return 0;
+    }
+    return n > 0 && (size_t)n < room;
+}
+
+/*
+ * saved_budget
+ *
+ * The budget saved for a machine with these caches, or 0.
+ */
+static size_t saved_budget(size_t l1, size_t l2)
+{
+    char path[4096];
+    if (!cache_path(path, sizeof(path))) {
+        return 0;
+    }
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    unsigned long a, b, budget, found = 0;
+    while (fscanf(fp, "%lu %lu %lu", &a, &b, &budget) == 3) {
+        if (a == l1 && b == l2 && budget >= SMALLEST && budget <= LARGEST) {
+            found = budget;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+/*
+ * save_budget
+ *
+ * Writes the line for this machine into the file of saved budgets,
+ * replacing the one for the same caches if there is one and keeping the
+ * rest, creating the file (and its directory) if need be, and stores its
+ * path in path. The new file is written beside the old one and renamed
+ * over it, so a reader never sees half of it. Returns 0 if it could not.
+ */
+static int save_budget(size_t l1, size_t l2, size_t budget, char *path,
+                       size_t room)
+{
+    char temp[4096 + 8];
+    if (!cache_path(path, room)) {
+        return 0;
+    }
+    char *slash = strrchr(path, '/');
+    *slash = '\0';
+    mkdir(path, 0755);          /* failing if it is there already */
+    *slash = '/';
+    snprintf(temp, sizeof(temp), "%s.new", path);
+    FILE *out = fopen(temp, "w");
+    if (out == NULL) {
+        return 0;
+    }
+
+    FILE *in = fopen(path, "r");
+    if (in != NULL) {
+        unsigned long a, b, old;
+        while (fscanf(in, "%lu %lu %lu", &a, &b, &old) == 3) {
+            if (a != l1 || b != l2) {
+                fprintf(out, "%lu %lu %lu\n", a, b, old);
+            }
+        }
+        fclose(in);
+    }
+    fprintf(out, "%zu %zu %zu\n", l1, l2, budget);
+    if (fclose(out) != 0 || rename(temp, path) != 0) {
+        remove(temp);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * block_side
+ *
+ * The side of the blocks UArray2b_new_fitting makes of cells of size
+ * bytes for budget.
+ */
+static size_t block_side(size_t budget, size_t size)
+{
+    size_t side = 1;
+    while (4 * side * side * size <= budget) {
+        side *= 2;
+    }
+    return side;
+}
+
+extern size_t Tune_block_bytes(void)
+{
+    if (tuned != 0) {
+        return tuned;
+    }
+    size_t l1, l2;
+    Tune_caches(&l1, &l2);
+    tuned = saved_budget(l1, l2);
+    if (tuned == 0) {
+        /* two blocks in half of L2; a line per column, of packed pixels
+           as in the sample image, in half of L1 */
+        tuned = SMALLEST;
+        while (tuned < LARGEST && 2 * (4 * tuned) <= l2 / 2 &&
+               block_side(4 * tuned, SAMPLE_SIZE) * LINE <= l1 / 2) {
+            tuned *= 4;
+        }
+    }
+    return tuned;
+}
+
+/*
+ * time_budget
+ *
+ * The best time, in nanoseconds, of rotating the sample image by 90
+ * degrees in blocks of at most budget bytes.
+ */
+static double time_budget(size_t budget, CPUTime_T timer)
+{
+    A2Methods_T methods = uarray2_methods_blocked;
+    A2Methods_UArray2 src, dst;
+    src = UArray2b_new_fitting(SAMPLE_WIDTH, SAMPLE_HEIGHT, SAMPLE_SIZE,
+                               budget);
+    dst = UArray2b_new_fitting(SAMPLE_HEIGHT, SAMPLE_WIDTH, SAMPLE_SIZE,
+                               budget);
+
+    /* a first copy faults in both images, and is not counted */
+    int ok = Kernels_transform(methods, methods->map_block_major, src, dst,
+                               ORIENT_ROT90);
+    assert(ok);
+    double best = 0;
+    for (int i = 0; i < TRIES; i++) {
+        CPUTime_Start(timer);
+        Kernels_transform(methods, methods->map_block_major, src, dst,
+                          ORIENT_ROT90);
+        double t = CPUTime_Stop(timer);
+        if (i == 0 || t < best) {
+            best = t;
+        }
+    }
+    methods->free(&src);
+    methods->free(&dst);
+    return best;
+}
+
+extern size_t Tune_calibrate(FILE *log)
+{
+    size_t l1, l2;
+    Tune_caches(&l1, &l2);
+    if (log != NULL) {
+        fprintf(log, "caches: L1 %zuKB, L2 %zuKB\n", l1 >> 10, l2 >> 10);
+    }
+
+    CPUTime_T timer = CPUTime_New();
+    assert(timer != NULL);
+    size_t best = 0;
+    double fastest = 0;
+    for (size_t budget = SMALLEST; budget <= LARGEST; budget *= 4) {
+        double t = time_budget(budget, timer);
+        if (log != NULL) {
+            fprintf(log, "blocks of up to %zuKB: %.2f ms\n", budget >> 10,
+                    t / 1e6);
+        }
+        if (best == 0 || t < fastest) {
+            best = budget;
+            fastest = t;
+        }
+    }
+    CPUTime_Free(&timer);
+
+    tuned = best;
+    char path[4096];
+    int saved = save_budget(l1, l2, best, path, sizeof(path));
+    if (log != NULL) {
+        if (saved) {
+            fprintf(log, "chose %zuKB, saved in %s\n", best >> 10, path);
+        } else {
+            fprintf(log, "chose %zuKB, but could not save it\n",
+                    best >> 10);
+        }
+    }
+    return best;
+}
+
+extern void Tune_set_tiles(int tilewidth, int tileheight)
+{
+    assert((tilewidth > 0 && tileheight > 0) ||
+           (tilewidth == 0 && tileheight == 0));
+    tiles[0] = tilewidth;
+    tiles[1] = tileheight;
+}
+
+extern int Tune_tiles(int *tilewidth, int *tileheight)
+{
+    assert(tilewidth != NULL && tileheight != NULL);
+    if (tiles[0] == 0) {
+        return 0;
+    }
+    *tilewidth = tiles[0];
+    *tileheight = tiles[1];
+    return 1;
+}
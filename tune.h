@@ -0,0 +1,78 @@
+/*
+ * tune.h
+ *
+ * Interface for fitting the blocks of blocked arrays (see uarray2b.h) to
+ * the machine they run on. The best block is as big as will stay in cache
+ * while a kernel copies it, which depends on the sizes of the caches and
+ * varies several times over between processors.
+ *
+ * Tune_block_bytes starts from the data cache sizes the system reports.
+ * Tune_calibrate goes further: it times a 90 degree rotation of a sample
+ * image with each candidate budget and keeps the fastest, saving it in a
+ * small file ($XDG_CACHE_HOME/ppmtrans-blocks, or ~/.cache/ppmtrans-blocks)
+ * keyed by the cache sizes, so that it is done once per kind of machine
+ * and a home directory shared between machines holds an answer for each;
+ * calibrating again replaces the answer for the machine's caches.
+ *
+ * A client can instead fix the shape of the blocks outright, as tiles of
+ * any width and height, with Tune_set_tiles.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef TUNE_INCLUDED
+#define TUNE_INCLUDED
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Tune_caches
+ *
+ * Stores the sizes of a core's level 1 data cache and level 2 cache, in
+ * bytes, in *l1 and *l2: from sysconf, else from
+ * /sys/devices/system/cpu/cpu0/cache, else 32KB and 256KB.
+ */
+extern void   Tune_caches(size_t *l1, size_t *l2);
+
+/*
+ * Tune_block_bytes
+ *
+ * The most bytes a block of a new blocked array should take: the budget
+ * Tune_calibrate saved for this machine, if there is one, otherwise the
+ * biggest of the candidates (4KB, 16KB, ... 1MB, each four times the
+ * last, so that the blocks of each are twice as wide) for which a
+ * source and a destination block together fill no more than half of the
+ * level 2 cache, and a cache line for each column of a block of packed
+ * pixels (see ppmio.h) fills no more than half of the level 1 cache: a
+ * rotation writes a row of the block across that many destination
+ * lines, which should stay in L1 until they are full. Worked out once
+ * per run.
+ */
+extern size_t Tune_block_bytes(void);
+
+/*
+ * Tune_calibrate
+ *
+ * Times the candidate budgets, makes the fastest the one Tune_block_bytes
+ * returns, and saves it for later runs. A line per candidate, and where
+ * the result was saved (or that it could not be), is written to log if it
+ * is not NULL.
+ *
+ * Returns: the budget chosen.
+ */
+extern size_t Tune_calibrate(FILE *log);
+
+/*
+ * Tune_set_tiles, Tune_tiles
+ *
+ * Tune_set_tiles makes the blocked suite's new (see a2blocked.h) cut
+ * arrays into tilewidth x tileheight tiles rather than square blocks of
+ * Tune_block_bytes; 0 x 0 goes back to square blocks, and any other
+ * size below 1 is a CRE. Tune_tiles returns 1, storing the tile shape
+ * in *tilewidth and *tileheight, if one is set, and 0 otherwise.
+ */
+extern void   Tune_set_tiles(int tilewidth, int tileheight);
+extern int    Tune_tiles(int *tilewidth, int *tileheight);
+
+#endif
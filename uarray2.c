@@ -13,16 +13,16 @@
  *
  **************************************************************/
 
-#include "uarray.h"
 #include "uarray2.h"
+#include "slab.h"
 
 /*
  * UArray2_new
  * 
- * Creates a new UArray2_T object. Yses the UArray_T interface to achieve
- * this. Information about the width and height is loaded into a 
- * struct malloced on the heap to ensure all information is
- * readily accessible
+ * Creates a new UArray2_T object. Every element lives in a single slab
+ * aligned to a cache line, with rows stored back to back and the row
+ * stride kept in the struct so indexing is a multiply-add rather than
+ * a walk through one UArray_T per row.
  * 
  * Parameters: The width and height of the two-dimensional UArray,
  *             and the maximum size (in bytes) of elements stored
@@ -38,11 +38,9 @@ UArray2_T UArray2_new(int width, int height, int size)
     assert(size>0);
     struct UArray2_T *uarr2 = malloc(sizeof(struct UArray2_T));
     assert(uarr2 != NULL);
-    uarr2->uarray2d = UArray_new(height, sizeof(uarr2->uarray2d));
-    assert(uarr2->uarray2d);
-    for (int i = 0; i < height; i++) {
-        *(UArray_T *)UArray_at(uarr2->uarray2d, i) = UArray_new(width, size);
-    }
+    uarr2->stride = (size_t)width * size;
+    uarr2->elems = Slab_alloc(uarr2->stride * height, SLAB_CACHE_LINE);
+
     uarr2->width = width;
     uarr2->height = height;
     uarr2->size = size;
@@ -101,10 +99,9 @@ int UArray2_size(UArray2_T UA2D)
 /*
  * UArray2_at
  * 
- * Returns the element at the specified location. The UArray_T
- * interface is once again used to return the spot in the 2D array
- * we are looking for since this representation is a UArray_T
- * of UArray_T's
+ * Returns the element at the specified location. Since the elements
+ * sit in one slab, the address is computed directly from the row stride
+ * and the element size.
  * 
  * Parameters: A UArray2_T object, and the width and height at which the
  *             sought element is located.
@@ -118,9 +115,7 @@ void *UArray2_at(UArray2_T UA2D, int col, int row)
     assert(UA2D != NULL);
     assert(col >= 0 && col < UA2D->width);
     assert(row >= 0 && row < UA2D->height);
-    assert(UA2D->uarray2d != NULL);
-    UArray_T *temp = UArray_at(UA2D->uarray2d, row);
-    return UArray_at(*temp, col);
+    return UA2D->elems + row * UA2D->stride + (size_t)col * UA2D->size;
 }
 /*
  * UArray2_map_col_major
@@ -146,18 +141,66 @@ void UArray2_map_col_major(UArray2_T UA2D,
     assert(UA2D != NULL);
     assert(apply != NULL);
     for (int i = 0; i < UA2D->width; i++) {
+        char *element = UA2D->elems + (size_t)i * UA2D->size;
         for (int j = 0; j < UA2D->height; j++) {
-            void *element = UArray2_at(UA2D, i, j);
-           apply(i, j, UA2D, element, acc);
+            apply(i, j, UA2D, element, acc);
+            element += UA2D->stride;
         }
     }
 }
+/*
+ * UArray2_map_rows
+ * 
+ * Traverse through the two-dimensional UArray one row at a time, handing
+ * the apply function each row as a contiguous run of elements.
+ * 
+ * Parameters: A UArray2_T object, a function pointer that does work on
+ *             a run of n elements starting at (col, row), void pointer
+ *             pointing to an accumulator.
+ * 
+ * Expectations: The reference to the UArray2_T is valid - i.e., not a null
+ *               pointer The referenced UArray2_T has width and height >= 0.
+ */
+void UArray2_map_rows(UArray2_T UA2D, 
+                      void apply(int col, int row, int n, UArray2_T UA2D, 
+                      void *span, void *acc),
+                      void *acc) 
+{
+    assert(UA2D != NULL);
+    assert(apply != NULL);
+    if (UA2D->width == 0) {
+        return;
+    }
+    for (int j = 0; j < UA2D->height; j++) {
+        apply(0, j, UA2D->width, UA2D, UA2D->elems + j * UA2D->stride, acc);
+    }
+}
+
+/* Closure that lets UArray2_map_row_major ride on UArray2_map_rows */
+struct row_closure {
+    void (*apply)(int col, int row, UArray2_T UA2D, void *element, 
+                  void *acc);
+    void *acc;
+};
+
+static void apply_row(int col, int row, int n, UArray2_T UA2D, void *span,
+                      void *vcl)
+{
+    struct row_closure *cl = vcl;
+    char *element = span;
+    for (int i = col; i < col + n; i++) {
+        cl->apply(i, row, UA2D, element, cl->acc);
+        element += UA2D->size;
+    }
+}
+
 /*
  * UArray2_map_row_major
  * 
  * Traverse through the two-dimensional UArray and apply the function in the
  * second parameter to the element in the specified index. Row-oriented
  * traversal, meaning column numbers change faster than row numbers.
+ * Implemented as a walk over the runs UArray2_map_rows hands out.
  * 
  * Parameters: A UArray2_T object, a function pointer that does work on a
  *             specific element of the 2D array, void pointer pointing to
@@ -174,12 +217,26 @@ void UArray2_map_row_major(UArray2_T UA2D,
 {
     assert(UA2D != NULL);
     assert(apply != NULL);
-    for (int j = 0; j < UA2D->height; j++) {
-        for (int i = 0; i < UA2D->width; i++) {
-            void *element = UArray2_at(UA2D, i, j);
-           apply(i, j, UA2D, element, acc);
-        }
-    }
+    struct row_closure cl = { apply, acc };
+    UArray2_map_rows(UA2D, apply_row, &cl);
+}
+/*
+ * UArray2_reshape
+ * 
+ * Reinterprets the slab as a width x height array. Rows are stored back
+ * to back, so only the dimensions and the row stride change.
+ * 
+ * Expectations: The reference is valid, and width * height equals the
+ *               current number of elements. CRE otherwise.
+ */
+void UArray2_reshape(UArray2_T UA2D, int width, int height)
+{
+    assert(UA2D != NULL);
+    assert(width >= 0 && height >= 0);
+    assert((size_t)width * height == (size_t)UA2D->width * UA2D->height);
+    UA2D->width = width;
+    UA2D->height = height;
+    UA2D->stride = (size_t)width * UA2D->size;
 }
 /*
  * UArray2_free
@@ -197,11 +254,7 @@ void UArray2_map_row_major(UArray2_T UA2D,
 void UArray2_free(UArray2_T *UA2D)
 {
     assert(UA2D != NULL);
-    for (int i = 0; i < (*UA2D)->height; i++) {
-        UArray_free((UArray_T *)UArray_at((*UA2D)->uarray2d, i));
-    }
-
-    UArray_free((UArray_T *)&((*UA2D)->uarray2d));
+    Slab_free((*UA2D)->elems);
     free(*UA2D);
 
 }
@@ -18,14 +18,18 @@
 #define __UArray2__
 
 
-#include "uarray.h"
 #include "assert.h"
 #include <stdlib.h>
 #include <stdio.h>
 
-
+/*
+ * All elements live in one slab, row after row. Element (col, row) is
+ * found at elems + row * stride + col * size, so a row-major walk
+ * streams straight through memory.
+ */
 struct UArray2_T {
-    UArray_T uarray2d;
+    char *elems;
+    size_t stride;
     int width;
     int height;
     int size;    
@@ -157,10 +161,37 @@ void UArray2_map_row_major(UArray2_T UA2D,
                                              void *element, void *acc),
                                   void *acc);
 
-
-
-
-
+/*
+ * UArray2_map_rows
+ * 
+ * Traverse through the two-dimensional UArray one row at a time, handing
+ * the apply function a pointer to the first element of the row and the
+ * number of elements in it. The elements of a row are contiguous, so the
+ * apply function can walk them with a pointer.
+ * 
+ * Parameters: A UArray2_T object, a function pointer that does work on
+ *             a run of n elements starting at (col, row), void pointer
+ *             pointing to an accumulator.
+ * 
+ * Expectations: The reference to the UArray2_T is valid - i.e., not a null
+ *               pointer. The referenced UArray2_T has width and height >= 0.
+ */
+void UArray2_map_rows(UArray2_T UA2D, 
+                      void apply(int col, int row, int n, UArray2_T UA2D, 
+                                 void *span, void *acc),
+                      void *acc);
+/*
+ * UArray2_reshape
+ * 
+ * Reinterprets the elements as a width x height array, keeping them
+ * where they are in the slab (so element k of the slab, counting in
+ * row-major order, stays element k). Used after the elements have been
+ * permuted in place, e.g. by an in-place transpose.
+ * 
+ * Expectations: width * height equals the number of elements in the
+ *               array. CRE otherwise.
+ */
+void UArray2_reshape(UArray2_T UA2D, int width, int height);
 
 #undef UArray2_T
 #endif
\ No newline at end of file
@@ -10,46 +10,65 @@
  */ 
 
 #include "uarray2b.h"
-#include "uarray2.h"
-#include "uarray.h"
+#include "slab.h"
+#include "assert.h"
 #include <stdlib.h>
 #include <stdio.h>
-#include <math.h>
 
 #define T UArray2b_T
 
+/*
+ * The blocks live back to back in one slab, in block-major order (the
+ * blocks themselves in row-major order). Every block is blockbytes
+ * long and starts on a cache-line boundary, or on a page boundary once
+ * a block is at least a page. Edge blocks keep their padding cells so
+ * that all blocks have the same shape. A block is a tile of tilewidth x
+ * tileheight cells, stored row by row; square blocks are the tiles with
+ * tilewidth == tileheight == blocksize.
+ */
 struct T {
-    UArray2_T matrix;
+    char *blocks;
+    size_t blockbytes;
     int width;
     int height;
     int size;
     int blockwidth;
     int blockheight;
-    int blocksize;
+    int tilewidth;
+    int tileheight;
+    int log2tilewidth;  /* log2 of tilewidth, or -1 if not a power of 2 */
+    int log2tileheight;
 };
 
+/* The log2 of n, or -1 if n is not a power of two */
+static int log2_of(int n)
+{
+    return (n & (n - 1)) == 0 ? __builtin_ctz(n) : -1;
+}
+
 /*
  * UArray2b_new
  * 
  * Creates a new blocked two-dimensional UArray
  * 
  * Parameters: the width and height of the array, the size of the elements, and
- *             the size (each dimension) of the blocks.
+ *             the width and height of the blocks, in cells.
  * 
  * Returns: a UArray2b object
  * 
- * Expectations: width, height, and size are valid values for the new array,
- *               blocksize = square root of # of cells per block.
+ * Expectations: width, height, and size are valid values for the new array.
  *            
- *               blocksize < 1 is a checked runtime error 
+ *               tilewidth or tileheight < 1 is a checked runtime error 
  */
-extern T UArray2b_new (int width, int height, int size, int blocksize) 
+extern T UArray2b_new (int width, int height, int size, int tilewidth,
+                       int tileheight) 
 {
     /* Asserts */
     assert(width > 0);
     assert(height > 0);
     assert(size > 0);
-    assert(blocksize > 0);
+    assert(tilewidth > 0);
+    assert(tileheight > 0);
 
     /* Malloc space for the blocked array */
     T blockarr = malloc(sizeof(struct T));
@@ -59,62 +78,81 @@ extern T UArray2b_new (int width, int height, int size, int blocksize)
     blockarr->width = width;
     blockarr->height = height;
     blockarr->size = size;
-    blockarr->blocksize = blocksize;
+    blockarr->tilewidth = tilewidth;
+    blockarr->tileheight = tileheight;
+    blockarr->log2tilewidth = log2_of(tilewidth);
+    blockarr->log2tileheight = log2_of(tileheight);
     
     /* Calculate the remaining member variables of the blocked array */
-    if (width % blocksize == 0) {
-        blockarr->blockwidth = width / blocksize;
+    if (width % tilewidth == 0) {
+        blockarr->blockwidth = width / tilewidth;
     } else {
-        blockarr->blockwidth = (width / blocksize) + 1;
+        blockarr->blockwidth = (width / tilewidth) + 1;
     }
-    if (height % blocksize == 0) {
-        blockarr->blockheight = height / blocksize;
+    if (height % tileheight == 0) {
+        blockarr->blockheight = height / tileheight;
     } else {
-        blockarr->blockheight = (height / blocksize) + 1;
+        blockarr->blockheight = (height / tileheight) + 1;
     }
     
-    /* Set the UArray2_T member variable equal to a new UArray2 */
-    blockarr->matrix = UArray2_new(blockarr->blockwidth, 
-                                    blockarr->blockheight, sizeof(UArray_T));
-
-    /* Loop through blocked array and initialize one-dimensional UArrays */
-    for (int i = 0; i < blockarr->blockheight; i++) {
-        for (int j = 0; j < blockarr->blockwidth; j++) {
-            *(UArray_T *)UArray2_at(blockarr->matrix, j,
-            i) = UArray_new(blocksize * blocksize, size);
-        }
+    /* Pad each block out to a cache line, or to a page if it is big */
+    size_t align = SLAB_CACHE_LINE;
+    blockarr->blockbytes = (size_t)tilewidth * tileheight * size;
+    if (blockarr->blockbytes >= SLAB_PAGE) {
+        align = SLAB_PAGE;
     }
+    blockarr->blockbytes = Slab_round(blockarr->blockbytes, align);
+
+    /* One slab holds every block */
+    blockarr->blocks = Slab_alloc(blockarr->blockbytes * 
+                                  blockarr->blockwidth * 
+                                  blockarr->blockheight, align);
 
     /* Return the created blocked array */
     return blockarr;
 }
 
 /*
- * UArray2b_new_64K
+ * UArray2b_new_fitting
  * 
  * Creates a new blocked two-dimensional UArray with maximum blocksize, where
- * block occupies at most 64KB.
+ * block occupies at most budget bytes. The blocksize is the largest power of
+ * two that fits, so that UArray2b_at and UArray2b_map can shift and mask
+ * instead of dividing.
  * 
- * Parameters: the width and height of the array, and the size of the elements.
+ * Parameters: the width and height of the array, the size of the elements,
+ *             and the most bytes a block may take.
  * 
  * Returns: a UArray2b object.
  * 
  * Expectations: width, height, and size are valid values for the new array.
  *            
  */
-extern T UArray2b_new_64K_block(int width, int height, int size) 
+extern T UArray2b_new_fitting(int width, int height, int size, size_t budget)
 {
     /* Asserts */
     assert(width > 0);
     assert(height > 0);
     assert(size > 0);
 
-    /* Check whether the element size is bigger than the max we want */
-    if (size > 65536) {
-        return UArray2b_new(width, height, size, 1);
-    } else {
-        return UArray2b_new(width, height, size, (int)sqrt((65536) / (size)));
+    /* Grow the blocksize by powers of two while a block still fits */
+    int blocksize = 1;
+    while (blocksize < (1 << 14) &&
+           (size_t)(2 * blocksize) * (2 * blocksize) * size <= budget) {
+        blocksize *= 2;
     }
+    return UArray2b_new(width, height, size, blocksize, blocksize);
+}
+
+/*
+ * UArray2b_new_64K
+ * 
+ * Creates a new blocked two-dimensional UArray whose blocks take at most
+ * 64KB.
+ */
+extern T UArray2b_new_64K_block(int width, int height, int size) 
+{
+    return UArray2b_new_fitting(width, height, size, 65536);
 }
 
 /*
@@ -130,17 +168,9 @@ extern T UArray2b_new_64K_block(int width, int height, int size)
 extern void UArray2b_free (T *array2b) 
 {
     assert(array2b != NULL);
+    assert(*array2b != NULL);
     
-    /* Go through and free the elements of the two-dimensional array */
-    for (int i = 0; i < (*array2b)->blockheight; i++) {
-        for (int j = 0; j < (*array2b)->blockwidth; j++) {
-            UArray_free(UArray2_at((*array2b)->matrix, j, i));
-        }
-    }
-    
-    /* Free the matrix */
-    UArray2_free(&(*array2b)->matrix);
-    
+    Slab_free((*array2b)->blocks);
     free(*array2b);
 }
 
@@ -199,10 +229,38 @@ extern int UArray2b_size (T array2b)
 
 }
 
+/*
+ * UArray2b_tilewidth
+ * 
+ * Returns the width of the UArray2b's tiles, in cells.
+ * 
+ * Expectations: the passed UArray2b is valid
+ */
+extern int UArray2b_tilewidth(T array2b)
+{
+    assert(array2b != NULL);
+    return array2b->tilewidth;
+}
+
+/*
+ * UArray2b_tileheight
+ * 
+ * Returns the height of the UArray2b's tiles, in cells.
+ * 
+ * Expectations: the passed UArray2b is valid
+ */
+extern int UArray2b_tileheight(T array2b)
+{
+    assert(array2b != NULL);
+    return array2b->tileheight;
+}
+
 /*
  * UArray2b_blocksize
  * 
- * Returns the blocksize of the UArray2b
+ * Returns the blocksize of the UArray2b: the height of its tiles, which
+ * is also their width unless they were made rectangular (see
+ * UArray2b_tilewidth).
  * 
  * Parameters: the UArray2b to get the blocksize of.
  * 
@@ -214,7 +272,7 @@ extern int UArray2b_size (T array2b)
 extern int UArray2b_blocksize(T array2b) 
 {
     assert(array2b != NULL);
-    return array2b->blocksize;
+    return array2b->tileheight;
 }
 
 /*
@@ -238,55 +296,165 @@ extern void *UArray2b_at(T array2b, int column, int row)
     assert(column < array2b->width && column >= 0);
     assert(row < array2b->height && row >= 0);
 
+    int tilewidth = array2b->tilewidth;
+    int tileheight = array2b->tileheight;
+    int blockcol, blockrow, cellcol, cellrow;
+
+    /* Split the indices into block and in-block parts */
+    if (array2b->log2tilewidth >= 0 && array2b->log2tileheight >= 0) {
+        blockcol = column >> array2b->log2tilewidth;
+        blockrow = row >> array2b->log2tileheight;
+        cellcol = column & (tilewidth - 1);
+        cellrow = row & (tileheight - 1);
+    } else {
+        blockcol = column / tilewidth;
+        blockrow = row / tileheight;
+        cellcol = column % tilewidth;
+        cellrow = row % tileheight;
+    }
+
     /* Get the block */
-    UArray_T *temp = UArray2_at(array2b->matrix, column / array2b->blocksize, 
-                     row / array2b->blocksize);
+    char *block = array2b->blocks + array2b->blockbytes * 
+                  ((size_t)blockrow * array2b->blockwidth + blockcol);
 
     /* Get the element within the block */
-    return UArray_at(*temp, (array2b->blocksize * (row % array2b->blocksize)) + 
-           column % array2b->blocksize);
-    }
+    return block + (size_t)array2b->size * (tilewidth * cellrow + cellcol);
+}
 
 /*
- * UArray2b_map
+ * UArray2b_swap_dimensions
  * 
- * Traverses the UArray2b in block-major order (meaning it traverses the blocks
- * in row-major order).
+ * Swaps width with height, blockwidth with blockheight, and tilewidth
+ * with tileheight: the cells of a block, transposed where they lie, are
+ * a tile of the transposed shape.
  * 
- * Parameters: the UArray2b to traverse, an apply function, and the closure
- *             argument.
+ * Expectations: the passed UArray2b is valid.
+ */
+extern void UArray2b_swap_dimensions(T array2b)
+{
+    assert(array2b != NULL);
+    int width = array2b->width;
+    int blockwidth = array2b->blockwidth;
+    array2b->width = array2b->height;
+    array2b->height = width;
+    array2b->blockwidth = array2b->blockheight;
+    array2b->blockheight = blockwidth;
+
+    int tilewidth = array2b->tilewidth;
+    int log2tilewidth = array2b->log2tilewidth;
+    array2b->tilewidth = array2b->tileheight;
+    array2b->tileheight = tilewidth;
+    array2b->log2tilewidth = array2b->log2tileheight;
+    array2b->log2tileheight = log2tilewidth;
+}
+
+/*
+ * UArray2b_get_layout
+ * 
+ * Fills in *layout with the raw geometry of the UArray2b.
+ * 
+ * Expectations: the passed UArray2b and layout are valid.
+ */
+extern void UArray2b_get_layout(T array2b, struct UArray2b_layout *layout)
+{
+    assert(array2b != NULL);
+    assert(layout != NULL);
+    layout->blocks = array2b->blocks;
+    layout->blockbytes = array2b->blockbytes;
+    layout->blockwidth = array2b->blockwidth;
+    layout->blockheight = array2b->blockheight;
+    layout->tilewidth = array2b->tilewidth;
+    layout->tileheight = array2b->tileheight;
+    layout->log2tilewidth = array2b->log2tilewidth;
+    layout->log2tileheight = array2b->log2tileheight;
+}
+
+/*
+ * UArray2b_map_blocks
+ * 
+ * Traverses the UArray2b one block at a time, in row-major order of the
+ * blocks. Each block is handed to apply as a tile clipped to the array:
+ * interior blocks are full, while blocks on the right and bottom edges
+ * report only their in-bounds columns and rows.
+ * 
+ * Parameters: the UArray2b to traverse, an apply function taking the
+ *             tile's origin, clipped extents, row pitch (in cells), and
+ *             first cell, and the closure argument.
  * 
  * Expectations: the passed UArray2b is valid.
  */
-extern void UArray2b_map(T array2b, void apply(int col, int row, T array2b,
-                         void *elem, void *cl), void *cl) 
+extern void UArray2b_map_blocks(T array2b, void apply(int col, int row,
+                                int width, int height, int pitch,
+                                T array2b, void *tile, void *cl), void *cl)
 {
     assert(array2b != NULL);
     assert(apply != NULL);
+
+    int tilewidth = array2b->tilewidth;
+    int tileheight = array2b->tileheight;
+    char *block = array2b->blocks;
     
     /* Go through the rows (of blocks) of the UArray2b */
     for (int brow = 0; brow < array2b->blockheight; brow++) {
+        int row0 = brow * tileheight;
+        int rows = array2b->height - row0;
+        if (rows > tileheight) {
+            rows = tileheight;
+        }
         
         /* Go through the columns (of blocks) of the UArray2b */
         for (int bcol = 0; bcol < array2b->blockwidth; bcol++) {
-            UArray_T *block = (UArray_T *)UArray2_at(array2b->matrix, bcol,
-                                                     brow);
-            
-            /*
-             * Go through the blocks themselves - i.e., go through the elements
-             * within the blocks in row-major order.
-             */
-            for (int k = 0; k < UArray_length(*block); k++) {
-                int col = (k % array2b->blocksize) + 
-                          (bcol * array2b->blocksize);
-                int row = (k / array2b->blocksize) + 
-                          (brow * array2b->blocksize);
-                
-                /* If column and row are in-bounds, call the apply function */
-                if (col < array2b->width && row < array2b->height) {
-                    apply(col, row, array2b, UArray_at(*block, k), cl);
-                }
+            int col0 = bcol * tilewidth;
+            int cols = array2b->width - col0;
+            if (cols > tilewidth) {
+                cols = tilewidth;
             }
+            apply(col0, row0, cols, rows, tilewidth, array2b, block, cl);
+            block += array2b->blockbytes;
         }
     }
 }
+
+/* Closure that lets UArray2b_map ride on UArray2b_map_blocks */
+struct cell_closure {
+    void (*apply)(int col, int row, T array2b, void *elem, void *cl);
+    void *cl;
+};
+
+static void apply_cells(int col, int row, int width, int height, int pitch,
+                        T array2b, void *tile, void *vcl)
+{
+    struct cell_closure *cl = vcl;
+    size_t size = array2b->size;
+
+    /* Go through the tile's cells in row-major order */
+    for (int r = 0; r < height; r++) {
+        char *elem = (char *)tile + size * pitch * r;
+        for (int c = 0; c < width; c++) {
+            cl->apply(col + c, row + r, array2b, elem, cl->cl);
+            elem += size;
+        }
+    }
+}
+
+/*
+ * UArray2b_map
+ * 
+ * Traverses the UArray2b in block-major order (meaning it traverses the blocks
+ * in row-major order). Each block is walked over its in-bounds part only,
+ * as handed out by UArray2b_map_blocks, so there is no bounds test per
+ * element.
+ * 
+ * Parameters: the UArray2b to traverse, an apply function, and the closure
+ *             argument.
+ * 
+ * Expectations: the passed UArray2b is valid.
+ */
+extern void UArray2b_map(T array2b, void apply(int col, int row, T array2b,
+                         void *elem, void *cl), void *cl) 
+{
+    assert(array2b != NULL);
+    assert(apply != NULL);
+    struct cell_closure mycl = { apply, cl };
+    UArray2b_map_blocks(array2b, apply_cells, &mycl);
+}
@@ -0,0 +1,147 @@
+/*
+ * uarray2b.h
+ *
+ * Interface for uarray2b, a two-dimensional blocked uarray. The array is
+ * cut into blocks, blocksize x blocksize or rectangular tiles of any
+ * width and height; cells of one block are stored together, so a walk
+ * that stays inside a block stays in cache.
+ *
+ * It is a checked run-time error to pass a NULL T to any function in this 
+ * interface.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef UARRAY2B_INCLUDED
+#define UARRAY2B_INCLUDED
+
+#include <stddef.h>
+
+#define T UArray2b_T
+typedef struct T *T;
+
+/*
+ * UArray2b_new
+ * 
+ * Creates a new blocked two-dimensional UArray whose blocks are tiles
+ * tilewidth cells wide and tileheight cells high; either less than 1 is
+ * a CRE. For a square blocksize, pass it as both.
+ */
+extern T     UArray2b_new (int width, int height, int size, int tilewidth,
+                           int tileheight);
+
+/*
+ * UArray2b_new_fitting
+ * 
+ * Creates a new blocked two-dimensional UArray with the biggest square
+ * blocks, a power of two cells on a side, that occupy at most budget bytes each
+ * (a blocksize of 1 if one cell is bigger than that).
+ */
+extern T     UArray2b_new_fitting(int width, int height, int size,
+                                  size_t budget);
+
+/*
+ * UArray2b_new_64K_block
+ * 
+ * UArray2b_new_fitting with a budget of 64KB.
+ */
+extern T     UArray2b_new_64K_block(int width, int height, int size);
+
+extern void  UArray2b_free     (T *array2b);
+
+extern int   UArray2b_width    (T array2b);
+extern int   UArray2b_height   (T array2b);
+extern int   UArray2b_size     (T array2b);
+
+/*
+ * UArray2b_tilewidth, UArray2b_tileheight
+ * 
+ * Return the width and height of the tiles, in cells.
+ */
+extern int   UArray2b_tilewidth (T array2b);
+extern int   UArray2b_tileheight(T array2b);
+
+/*
+ * UArray2b_blocksize
+ * 
+ * Returns the side of square blocks. For rectangular tiles it returns
+ * their height, the rows a block row spans, which is what a caller that
+ * walks the array a block row at a time needs; use UArray2b_tilewidth
+ * for the other side.
+ */
+extern int   UArray2b_blocksize(T array2b);
+
+/*
+ * UArray2b_at
+ * 
+ * Returns a pointer to the cell in the given column and row. Index out of
+ * range is a checked run-time error.
+ */
+extern void *UArray2b_at(T array2b, int column, int row);
+
+/*
+ * UArray2b_map
+ * 
+ * Visits every cell, one block at a time (blocks in row-major order, and
+ * cells within a block in row-major order).
+ */
+extern void  UArray2b_map(T array2b, 
+                          void apply(int col, int row, T array2b,
+                                     void *elem, void *cl), 
+                          void *cl);
+
+/*
+ * UArray2b_map_blocks
+ * 
+ * Visits every block in the same order as UArray2b_map, handing apply the
+ * block as a tile: the column and row of its top-left cell, the number of
+ * columns and rows of it that lie inside the array (less than the tile's
+ * width and height only for the blocks on the right and bottom edges),
+ * the pitch between the tile's rows in cells (its width), and a pointer
+ * to its first cell.
+ */
+extern void  UArray2b_map_blocks(T array2b, 
+                                 void apply(int col, int row, int width,
+                                            int height, int pitch,
+                                            T array2b, void *tile, 
+                                            void *cl),
+                                 void *cl);
+
+/*
+ * UArray2b_swap_dimensions
+ * 
+ * Swaps the width and height of the array, the number of blocks across
+ * and down, and the width and height of the tiles, leaving the slab as
+ * it is. Used after the blocks have been transposed in place: each
+ * block's cells transposed within the block, and the blocks themselves
+ * transposed as a grid.
+ */
+extern void  UArray2b_swap_dimensions(T array2b);
+
+/*
+ * The raw geometry of a UArray2b, for kernels that address cells
+ * directly: block (bcol, brow) starts blockbytes * (brow * blockwidth +
+ * bcol) bytes into blocks, and its tilewidth x tileheight cells are
+ * stored in row-major order. log2tilewidth is -1 unless tilewidth is a
+ * power of two, and likewise log2tileheight.
+ */
+struct UArray2b_layout {
+    char *blocks;
+    size_t blockbytes;
+    int blockwidth;
+    int blockheight;
+    int tilewidth;
+    int tileheight;
+    int log2tilewidth;
+    int log2tileheight;
+};
+
+/*
+ * UArray2b_get_layout
+ * 
+ * Fills in *layout with the geometry of the UArray2b.
+ */
+extern void  UArray2b_get_layout(T array2b, struct UArray2b_layout *layout);
+
+#undef T
+#endif
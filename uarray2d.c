@@ -0,0 +1,256 @@
+/*
+ * uarray2d.c
+ *
+ * Implementation file for uarray2d, a two-dimensional blocked uarray
+ * that lives on disk.
+ *
+ * It is a checked run-time error to pass a NULL T to any function in this
+ * interface.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#include "uarray2d.h"
+#include "slab.h"
+#include "assert.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define T UArray2d_T
+
+/*
+ * The blocks are laid out in the file as a UArray2b lays them out in
+ * its slab: back to back, in row-major order, blockbytes each. The file
+ * is created at full length but sparse, so blocks never written read
+ * back as zeros. In memory there are slots for a few blocks; resident
+ * maps a slot to the block in it and slot maps a block to its slot (or
+ * -1). Slots are reused least recently used first.
+ */
+struct T {
+    int width;
+    int height;
+    int size;
+    int blocksize;
+    int blockwidth;
+    int blockheight;
+    size_t blockbytes;
+    int fd;
+
+    int slots;
+    char *cache;                /* slots * blockbytes */
+    int *resident;              /* per slot: block number, or -1 */
+    unsigned char *dirty;       /* per slot */
+    unsigned long *used;        /* per slot: when last handed out */
+    unsigned long clock;
+    int *slot;                  /* per block: slot, or -1 */
+};
+
+/*
+ * spill_file
+ *
+ * Opens a new temporary file in $TMPDIR, or /var/tmp if that is not set,
+ * and unlinks it at once so that closing it is all it takes to remove
+ * it. /var/tmp rather than /tmp because the file holds a whole image
+ * that was too big for memory, and /tmp is often in memory itself.
+ *
+ * Returns: its file descriptor, or -1 if it could not be made
+ */
+static int spill_file(void)
+{
+    const char *dir = getenv("TMPDIR");
+    if (dir == NULL || *dir == '\0') {
+        dir = "/var/tmp";
+    }
+    size_t room = strlen(dir) + sizeof("/uarray2d-XXXXXX");
+    char *path = malloc(room);
+    assert(path != NULL);
+    snprintf(path, room, "%s/uarray2d-XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        unlink(path);
+    }
+    free(path);
+    return fd;
+}
+
+/*
+ * UArray2d_new
+ *
+ * Creates a new disk-backed blocked two-dimensional UArray
+ *
+ * Parameters: the width and height of the array, the size of the
+ *             elements, the size (each dimension) of the blocks, and how
+ *             many bytes of blocks may be held in memory.
+ *
+ * Returns: a UArray2d object
+ *
+ * Expectations: width, height, and size are valid values for the new
+ *               array; blocksize < 1 is a checked runtime error
+ */
+extern T UArray2d_new(int width, int height, int size, int blocksize,
+                      size_t memory)
+{
+    assert(width > 0);
+    assert(height > 0);
+    assert(size > 0);
+    assert(blocksize > 0);
+
+    T array = malloc(sizeof(*array));
+    assert(array != NULL);
+    array->width = width;
+    array->height = height;
+    array->size = size;
+    array->blocksize = blocksize;
+    array->blockwidth = (width + blocksize - 1) / blocksize;
+    array->blockheight = (height + blocksize - 1) / blocksize;
+    array->blockbytes = (size_t)size * blocksize * blocksize;
+
+    size_t blocks = (size_t)array->blockwidth * array->blockheight;
+    array->fd = spill_file();
+    assert(array->fd >= 0);
+    int sized = ftruncate(array->fd, (off_t)(blocks * array->blockbytes));
+    assert(sized == 0);
+
+    size_t slots = memory / array->blockbytes;
+    slots = slots < 1 ? 1 : slots;
+    slots = slots > blocks ? blocks : slots;
+    array->slots = slots;
+    array->cache = Slab_alloc(slots * array->blockbytes, SLAB_PAGE);
+    array->resident = malloc(slots * sizeof(int));
+    array->dirty = calloc(slots, 1);
+    array->used = calloc(slots, sizeof(unsigned long));
+    array->slot = malloc(blocks * sizeof(int));
+    assert(array->resident != NULL && array->dirty != NULL &&
+           array->used != NULL && array->slot != NULL);
+    for (size_t s = 0; s < slots; s++) {
+        array->resident[s] = -1;
+    }
+    for (size_t b = 0; b < blocks; b++) {
+        array->slot[b] = -1;
+    }
+    array->clock = 0;
+    return array;
+}
+
+/*
+ * UArray2d_free
+ *
+ * Frees the memory of the array; closing the temporary file removes it.
+ * Dirty blocks are dropped, not written back.
+ */
+extern void UArray2d_free(T *array2d)
+{
+    assert(array2d != NULL && *array2d != NULL);
+    T array = *array2d;
+    close(array->fd);
+    Slab_free(array->cache);
+    free(array->resident);
+    free(array->dirty);
+    free(array->used);
+    free(array->slot);
+    free(array);
+    *array2d = NULL;
+}
+
+extern int UArray2d_width(T array2d)
+{
+    assert(array2d != NULL);
+    return array2d->width;
+}
+
+extern int UArray2d_height(T array2d)
+{
+    assert(array2d != NULL);
+    return array2d->height;
+}
+
+extern int UArray2d_size(T array2d)
+{
+    assert(array2d != NULL);
+    return array2d->size;
+}
+
+extern int UArray2d_blocksize(T array2d)
+{
+    assert(array2d != NULL);
+    return array2d->blocksize;
+}
+
+/*
+ * transfer
+ *
+ * Reads or writes block number b from or to the memory at p.
+ */
+static void transfer(T array, int b, char *p, int writing)
+{
+    size_t n = array->blockbytes;
+    off_t offset = (off_t)b * (off_t)n;
+    while (n > 0) {
+        ssize_t done = writing ? pwrite(array->fd, p, n, offset)
+                               : pread(array->fd, p, n, offset);
+        assert(done > 0);
+        p += done;
+        n -= done;
+        offset += done;
+    }
+}
+
+/*
+ * UArray2d_block
+ *
+ * Finds the block's slot, or takes the least recently used slot for it,
+ * writing back whatever block was there if it changed.
+ */
+extern void *UArray2d_block(T array2d, int blockcol, int blockrow,
+                            int dirty)
+{
+    assert(array2d != NULL);
+    assert(blockcol >= 0 && blockcol < array2d->blockwidth);
+    assert(blockrow >= 0 && blockrow < array2d->blockheight);
+
+    T array = array2d;
+    int b = blockrow * array->blockwidth + blockcol;
+    int s = array->slot[b];
+
+    if (s < 0) {
+        s = 0;
+        for (int t = 1; t < array->slots; t++) {
+            if (array->used[t] < array->used[s]) {
+                s = t;
+            }
+        }
+        char *p = array->cache + s * array->blockbytes;
+        if (array->resident[s] >= 0) {
+            if (array->dirty[s]) {
+                transfer(array, array->resident[s], p, 1);
+            }
+            array->slot[array->resident[s]] = -1;
+        }
+        transfer(array, b, p, 0);
+        array->resident[s] = b;
+        array->slot[b] = s;
+        array->dirty[s] = 0;
+    }
+
+    array->used[s] = ++array->clock;
+    array->dirty[s] |= dirty != 0;
+    return array->cache + s * array->blockbytes;
+}
+
+/*
+ * UArray2d_at
+ *
+ * The cell's block, then the cell within it.
+ */
+extern void *UArray2d_at(T array2d, int column, int row)
+{
+    assert(array2d != NULL);
+    assert(column >= 0 && column < array2d->width);
+    assert(row >= 0 && row < array2d->height);
+
+    int bs = array2d->blocksize;
+    char *block = UArray2d_block(array2d, column / bs, row / bs, 1);
+    return block + (size_t)array2d->size * ((row % bs) * bs + column % bs);
+}
@@ -0,0 +1,74 @@
+/*
+ * uarray2d.h
+ *
+ * Interface for uarray2d, a two-dimensional blocked uarray that lives
+ * on disk. Like a UArray2b, the array is cut into blocksize x blocksize
+ * blocks, but the blocks are kept in an anonymous temporary file (in
+ * $TMPDIR, or /var/tmp) and paged in on demand: only as many blocks as
+ * fit in the memory budget given to UArray2d_new are ever in memory, and
+ * the least recently used one is written back (if it was changed) to
+ * make room for another.
+ *
+ * Pointers returned by UArray2d_block and UArray2d_at stay valid only
+ * until the next call to either, which may evict their block.
+ *
+ * It is a checked run-time error to pass a NULL T to any function in this
+ * interface.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef UARRAY2D_INCLUDED
+#define UARRAY2D_INCLUDED
+
+#include <stddef.h>
+
+#define T UArray2d_T
+typedef struct T *T;
+
+/*
+ * UArray2d_new
+ *
+ * Creates a new disk-backed blocked two-dimensional UArray whose cells
+ * are all zero, keeping at most memory bytes of blocks in memory (but
+ * always at least one block). blocksize < 1 is a CRE; failing to create
+ * the temporary file is a CRE.
+ */
+extern T     UArray2d_new (int width, int height, int size, int blocksize,
+                           size_t memory);
+
+/*
+ * UArray2d_free
+ *
+ * Frees the array and removes its temporary file.
+ */
+extern void  UArray2d_free     (T *array2d);
+
+extern int   UArray2d_width    (T array2d);
+extern int   UArray2d_height   (T array2d);
+extern int   UArray2d_size     (T array2d);
+extern int   UArray2d_blocksize(T array2d);
+
+/*
+ * UArray2d_block
+ *
+ * Pages in the block in the given block column and row and returns a
+ * pointer to its first cell; the cells of a block are stored in
+ * row-major order, blocksize to a row (edge blocks are padded). If
+ * dirty is nonzero the block will be written back before it is evicted.
+ * A block out of range is a CRE.
+ */
+extern void *UArray2d_block(T array2d, int blockcol, int blockrow,
+                            int dirty);
+
+/*
+ * UArray2d_at
+ *
+ * Returns a pointer to the cell in the given column and row, paging its
+ * block in and marking it dirty. Index out of range is a checked
+ * run-time error.
+ */
+extern void *UArray2d_at(T array2d, int column, int row);
+
+#undef T
+#endif
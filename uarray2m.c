@@ -0,0 +1,222 @@
+/*
+ * uarray2m.c
+ *
+ * Implementation file for uarray2m, a two-dimensional uarray stored in
+ * Z-order (Morton order).
+ *
+ * The array is cut into square tiles 2^k cells on a side, in a grid
+ * that is stored a row of tiles at a time: cell (col, row) lives in tile
+ * (row >> k) * tilecols + (col >> k), and within the tile its index is
+ * the bitwise interleave of the low k bits of col (even bits) and row
+ * (odd bits). k is the largest that keeps the padding of the grid to an
+ * eighth of width * height or less.
+ *
+ * It is a checked run-time error to pass a NULL T to any function in this 
+ * interface.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "uarray2m.h"
+#include "morton.h"
+#include "slab.h"
+#include "assert.h"
+
+#define T UArray2m_T
+
+struct T {
+    char *cells;
+    int width;
+    int height;
+    int size;
+    int log2side;   /* tiles are 2^log2side cells on a side */
+    int tilecols;   /* tiles across a row of tiles */
+    int tilerows;   /* rows of tiles */
+};
+
+/*
+ * padded_cells
+ * 
+ * The cells in a grid of tiles of side 2^k covering width x height.
+ */
+static uint64_t padded_cells(int width, int height, int k)
+{
+    uint64_t side = (uint64_t)1 << k;
+    return ((width + side - 1) >> k << k) * ((height + side - 1) >> k << k);
+}
+
+/*
+ * UArray2m_new
+ * 
+ * Creates a new Z-ordered two-dimensional UArray. The tiles start out
+ * as large as the short side rounded up to a power of two, and are
+ * halved until the grid of them wastes no more than an eighth of the
+ * cells; a side of one cell wastes none.
+ * 
+ * Parameters: the width and height of the array, and the size of the
+ *             elements.
+ * 
+ * Expectations: width and height are >= 0, size is > 0. CRE otherwise.
+ */
+extern T UArray2m_new(int width, int height, int size)
+{
+    assert(width >= 0);
+    assert(height >= 0);
+    assert(size > 0);
+
+    T array2m = malloc(sizeof(struct T));
+    assert(array2m != NULL);
+    array2m->width = width;
+    array2m->height = height;
+    array2m->size = size;
+
+    /* Smallest power of two covering the short side, then halved */
+    int shortside = width < height ? width : height;
+    uint64_t cells = (uint64_t)width * height;
+    int k = 0;
+    while ((1 << k) < shortside) {
+        k++;
+    }
+    while (padded_cells(width, height, k) > cells + cells / 8) {
+        k--;
+    }
+    int side = 1 << k;
+    array2m->log2side = k;
+    array2m->tilecols = (width + side - 1) / side;
+    array2m->tilerows = (height + side - 1) / side;
+
+    array2m->cells = Slab_alloc(padded_cells(width, height, k) * size,
+                                SLAB_CACHE_LINE);
+    return array2m;
+}
+
+/*
+ * UArray2m_free
+ * 
+ * Frees the space associated with the UArray2m.
+ */
+extern void UArray2m_free(T *array2m)
+{
+    assert(array2m != NULL);
+    assert(*array2m != NULL);
+    Slab_free((*array2m)->cells);
+    free(*array2m);
+    *array2m = NULL;
+}
+
+/*
+ * UArray2m_width
+ * 
+ * Returns the width of the UArray2m.
+ */
+extern int UArray2m_width(T array2m)
+{
+    assert(array2m != NULL);
+    return array2m->width;
+}
+
+/*
+ * UArray2m_height
+ * 
+ * Returns the height of the UArray2m.
+ */
+extern int UArray2m_height(T array2m)
+{
+    assert(array2m != NULL);
+    return array2m->height;
+}
+
+/*
+ * UArray2m_size
+ * 
+ * Returns the element size of the UArray2m.
+ */
+extern int UArray2m_size(T array2m)
+{
+    assert(array2m != NULL);
+    return array2m->size;
+}
+
+/*
+ * UArray2m_at
+ * 
+ * Return a pointer to the cell in the given column and row.
+ * 
+ * Expectations: Column and row are in bounds. CRE otherwise.
+ */
+extern void *UArray2m_at(T array2m, int column, int row)
+{
+    assert(array2m != NULL);
+    assert(column < array2m->width && column >= 0);
+    assert(row < array2m->height && row >= 0);
+
+    return array2m->cells + array2m->size * 
+           Morton_index(column, row, array2m->log2side, array2m->tilecols);
+}
+
+/*
+ * UArray2m_map
+ * 
+ * Walks the slab in storage order, which is the Z-curve within each
+ * tile. The coordinates are stepped along with the index: adding one to
+ * an index with t trailing one bits clears the low bits of col and row
+ * that those ones stood for and sets bit t, which belongs to col when t
+ * is even and to row when t is odd.
+ * 
+ * Parameters: the UArray2m to traverse, an apply function, and the
+ *             closure argument.
+ */
+extern void UArray2m_map(T array2m, void apply(int col, int row, T array2m,
+                         void *elem, void *cl), void *cl)
+{
+    assert(array2m != NULL);
+    assert(apply != NULL);
+
+    int side = 1 << array2m->log2side;
+    uint64_t cells = (uint64_t)side * side;
+    char *elem = array2m->cells;
+
+    size_t tiles = (size_t)array2m->tilecols * array2m->tilerows;
+
+    for (size_t tile = 0; tile < tiles; tile++) {
+        int col = 0;
+        int row = 0;
+        int col0 = (int)(tile % array2m->tilecols) * side;
+        int row0 = (int)(tile / array2m->tilecols) * side;
+
+        for (uint64_t k = 0; k < cells; k++) {
+            if (col0 + col < array2m->width && 
+                row0 + row < array2m->height) {
+                apply(col0 + col, row0 + row, array2m, elem, cl);
+            }
+            elem += array2m->size;
+
+            /* Step (col, row) to index k + 1 */
+            int t = __builtin_ctzll(~k);
+            col &= ~((1 << ((t + 1) / 2)) - 1);
+            row &= ~((1 << (t / 2)) - 1);
+            if (t % 2 == 0) {
+                col |= 1 << (t / 2);
+            } else {
+                row |= 1 << (t / 2);
+            }
+        }
+    }
+}
+
+/*
+ * UArray2m_get_layout
+ * 
+ * Fills in *layout with the raw geometry of the UArray2m.
+ */
+extern void UArray2m_get_layout(T array2m, struct UArray2m_layout *layout)
+{
+    assert(array2m != NULL);
+    assert(layout != NULL);
+    layout->cells = array2m->cells;
+    layout->log2side = array2m->log2side;
+    layout->tilecols = array2m->tilecols;
+    layout->tilerows = array2m->tilerows;
+}
@@ -0,0 +1,98 @@
+/*
+ * uarray2m.h
+ *
+ * Interface for UArray2m, a two-dimensional uarray whose elements are
+ * stored in Z-order (Morton order).
+ *
+ * The array is covered by a grid of square tiles of side 2^k, stored a
+ * row of tiles at a time; inside a tile, the cell at (col, row) lives at
+ * the index formed by interleaving the bits of col and row. Neighbours
+ * in either direction are therefore close in memory at every scale up to
+ * the tile, which is what a rotation or transpose wants. The tiles are
+ * as large as the short side allows, rounded up to a power of two, but
+ * no larger than keeps the padding past the right and bottom edges to an
+ * eighth of the cells: 1025x3000 gets 64-cell tiles and 1088x3008 cells,
+ * not 2048x3072.
+ *
+ * It is a checked run-time error to pass a NULL T to any function in this 
+ * interface.
+ *
+ * By: Jahansher Khan (jkhan03) and Tom Barnett-Young (tbarne02)
+ */
+
+#ifndef UARRAY2M_INCLUDED
+#define UARRAY2M_INCLUDED
+
+#include <stddef.h>
+
+#define T UArray2m_T
+typedef struct T *T;
+
+/*
+ * UArray2m_new
+ * 
+ * Creates a new Z-ordered two-dimensional UArray.
+ * 
+ * Parameters: the width and height of the array, and the size of the
+ *             elements.
+ * 
+ * Expectations: width and height are >= 0, size is > 0. CRE otherwise.
+ */
+extern T     UArray2m_new   (int width, int height, int size);
+
+/*
+ * UArray2m_free
+ * 
+ * Frees the space associated with the UArray2m and sets *array2m to NULL.
+ */
+extern void  UArray2m_free  (T *array2m);
+
+/*
+ * UArray2m_width, UArray2m_height, UArray2m_size
+ * 
+ * Return the width, height, and element size of the UArray2m.
+ */
+extern int   UArray2m_width (T array2m);
+extern int   UArray2m_height(T array2m);
+extern int   UArray2m_size  (T array2m);
+
+/*
+ * UArray2m_at
+ * 
+ * Returns a pointer to the cell in the given column and row.
+ * 
+ * Expectations: index out of range is a checked run-time error.
+ */
+extern void *UArray2m_at    (T array2m, int column, int row);
+
+/*
+ * UArray2m_map
+ * 
+ * Visits every cell in storage order, i.e. along the Z-curve, tile by
+ * tile. Padding cells past the right or bottom edge are skipped.
+ */
+extern void  UArray2m_map   (T array2m, 
+                             void apply(int col, int row, T array2m,
+                                        void *elem, void *cl),
+                             void *cl);
+
+/*
+ * The raw geometry of a UArray2m, for kernels that compute Z-order
+ * addresses themselves (see Morton_index in morton.h).
+ */
+struct UArray2m_layout {
+    char *cells;
+    int log2side;
+    int tilecols;
+    int tilerows;
+};
+
+/*
+ * UArray2m_get_layout
+ * 
+ * Fills in *layout with the geometry of the UArray2m.
+ */
+extern void  UArray2m_get_layout(T array2m, struct UArray2m_layout *layout);
+
+#undef T
+#endif
@@ -4,7 +4,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
-#include <uarray2b.h>
+#include "uarray2b.h"
 #include "uarray2.h"
 #include "uarray.h"
 
@@ -32,7 +32,7 @@ int main(int argc, char *argv[])
 
         UArray2b_T test_array;
         bool OK = true;
-        test_array = UArray2b_new(DIM1, DIM2, ELEMENT_SIZE, 3);
+        test_array = UArray2b_new(DIM1, DIM2, ELEMENT_SIZE, 3, 3);
 
 
         OK = (UArray2b_width(test_array) == DIM1) &&